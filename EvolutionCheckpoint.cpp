@@ -0,0 +1,188 @@
+#include "EvolutionCheckpoint.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <system_error>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+EvolutionCheckpointWriter::EvolutionCheckpointWriter(const std::string &bestConfigFileValue, const std::string &historyFile, bool appendHistory)
+{
+	bestConfigFile = bestConfigFileValue;
+	shouldShutdown = false;
+	savedBestFitness = UINT32_MAX;
+
+	historyStream.open(historyFile, appendHistory ? std::ios::app : std::ios::trunc);
+
+	if (!historyStream.is_open())
+	{
+		std::cout << "Failed to open file stream for evolution history file: \"" << historyFile << "\"" << std::endl;
+		exit(-1);
+	}
+
+	writerThread = std::thread(&EvolutionCheckpointWriter::threadMainFunction, this);
+}
+
+EvolutionCheckpointWriter::~EvolutionCheckpointWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		shouldShutdown = true;
+	}
+
+	queueCondition.notify_one();
+	writerThread.join();
+
+	exitIfWriteFailed();
+}
+
+void EvolutionCheckpointWriter::submit(EvolutionCheckpoint &&checkpoint)
+{
+	exitIfWriteFailed();
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queuedCheckpoints.push_back(std::move(checkpoint));
+	}
+
+	queueCondition.notify_one();
+}
+
+void EvolutionCheckpointWriter::threadMainFunction()
+{
+	std::unique_lock<std::mutex> lock(queueMutex);
+
+	while (true)
+	{
+		queueCondition.wait(lock, [this]() { return !queuedCheckpoints.empty() || shouldShutdown; });
+
+		// Only quits once everything queued before the shutdown has been written
+		if (queuedCheckpoints.empty())
+			break;
+
+		EvolutionCheckpoint checkpoint = std::move(queuedCheckpoints.front());
+		queuedCheckpoints.pop_front();
+
+		lock.unlock();
+		writeCheckpoint(checkpoint);
+		lock.lock();
+	}
+}
+
+void EvolutionCheckpointWriter::writeCheckpoint(const EvolutionCheckpoint &checkpoint)
+{
+	bool improved = checkpoint.bestFitness < savedBestFitness;
+
+	if (improved)
+	{
+		std::string error;
+
+		if (saveBestConfig(checkpoint.bestShellConfig, error))
+		{
+			savedBestFitness = checkpoint.bestFitness;
+		}
+		else
+		{
+			// Left for the main thread to report, which can stop the simulation
+			std::lock_guard<std::mutex> lock(queueMutex);
+
+			if (writeError.empty())
+				writeError = error;
+
+			improved = false;
+		}
+	}
+
+	json historyJSON;
+	historyJSON["generation"] = checkpoint.generation;
+	historyJSON["bestFitness"] = checkpoint.bestFitness;
+	historyJSON["generationMilliseconds"] = checkpoint.generationMilliseconds;
+	historyJSON["fitnessCacheHits"] = checkpoint.fitnessCacheHits;
+	historyJSON["fitnessCacheMisses"] = checkpoint.fitnessCacheMisses;
+	historyJSON["stealAttempts"] = checkpoint.stealAttempts;
+	historyJSON["stealSuccesses"] = checkpoint.stealSuccesses;
+	historyJSON["stolenJobs"] = checkpoint.stolenJobs;
+	historyJSON["receivedMigrants"] = checkpoint.receivedMigrants;
+
+	// One compact object per line, flushed so the log is complete up to the last generation if the run is killed
+	historyStream << historyJSON.dump() << std::endl;
+
+	std::cout << "Generation " << checkpoint.generation << ", best fitness: " << checkpoint.bestFitness << ", fitness cache hits/misses: " << checkpoint.fitnessCacheHits << "/" << checkpoint.fitnessCacheMisses
+		<< ", steals: " << checkpoint.stealSuccesses << "/" << checkpoint.stealAttempts << " (" << checkpoint.stolenJobs << " jobs)";
+
+	if (checkpoint.receivedMigrants > 0)
+		std::cout << ", received " << checkpoint.receivedMigrants << " migrants";
+
+	if (improved)
+		std::cout << ", saved to \"" << bestConfigFile << "\"";
+
+	std::cout << std::endl;
+}
+
+bool EvolutionCheckpointWriter::saveBestConfig(const ShellConfig &shellConfig, std::string &error)
+{
+	json shellConfigJSON;
+	shellConfigJSON["numAngles"] = shellConfig.numAngles;
+	shellConfigJSON["shellDiameter"] = shellConfig.shellDiameter;
+	shellConfigJSON["tapeWidth"] = shellConfig.tapeWidth;
+	shellConfigJSON["shellChuckDiameter"] = shellConfig.shellChuckDiameter;
+	shellConfigJSON["shellArmAngles"] = shellConfig.shellArmAngles;
+
+	std::vector<float> shellStepperSpeedFraction;
+
+	for (uint32_t a = 0; a < shellConfig.numAngles; a++)
+		shellStepperSpeedFraction.push_back(0.5f / shellConfig.shellStepperSpeed[a]);
+
+	shellConfigJSON["shellStepperSpeedFraction"] = shellStepperSpeedFraction;
+	shellConfigJSON["rimRotationsUntilNextAngle"] = shellStepperSpeedFraction;
+
+	const std::string temporaryFile = bestConfigFile + ".tmp";
+	std::ofstream lowestErrorResultFile(temporaryFile);
+
+	if (!lowestErrorResultFile.is_open())
+	{
+		error = "Failed to open file stream for output file: \"" + temporaryFile + "\" to write results of simulation!";
+		return false;
+	}
+
+	lowestErrorResultFile << std::setw(4) << shellConfigJSON << std::endl;
+	lowestErrorResultFile.close();
+
+	if (lowestErrorResultFile.fail())
+	{
+		error = "Failed to write output file: \"" + temporaryFile + "\"";
+		return false;
+	}
+
+	// Replaces the old config in one step, filesystem::rename() overwrites an existing file on every platform
+	std::error_code renameError;
+	std::filesystem::rename(temporaryFile, bestConfigFile, renameError);
+
+	if (renameError)
+	{
+		error = "Failed to replace output file: \"" + bestConfigFile + "\" with \"" + temporaryFile + "\": " + renameError.message();
+		return false;
+	}
+
+	return true;
+}
+
+void EvolutionCheckpointWriter::exitIfWriteFailed()
+{
+	std::string error;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		error = writeError;
+	}
+
+	if (!error.empty())
+	{
+		std::cout << error << std::endl;
+		exit(-1);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <ShellSimulation.h>
+
+// A snapshot of one generation's results, everything the checkpoint writer needs without touching the population again
+struct EvolutionCheckpoint
+{
+	uint32_t generation;
+	uint32_t bestFitness;
+	double generationMilliseconds;
+
+	uint64_t fitnessCacheHits;
+	uint64_t fitnessCacheMisses;
+
+	uint64_t stealAttempts;
+	uint64_t stealSuccesses;
+	uint64_t stolenJobs;
+
+	uint32_t receivedMigrants; // From the previous island in island mode, into the next generation
+
+	ShellConfig bestShellConfig;
+};
+
+/*
+Writes evolution results on a background thread, so the next generation's fitness jobs never wait on the disk or the console.
+
+Every checkpoint appends a line of stats to an NDJSON history log and is printed, but the best config is only rewritten when
+its fitness improved. It's written to a temporary file first and then renamed over the old one, so the file on disk is always
+a complete config even if the process dies mid write.
+
+The writer thread never exits the process itself, as the job system is still running. If writing the best config fails, the
+old file is kept, and the thread calling submit() (or the destructor) prints the error and exits.
+*/
+class EvolutionCheckpointWriter
+{
+public:
+
+	/*
+	@param[in] bestConfigFile Where the best config is written to
+	@param[in] historyFile The NDJSON log, truncated unless appendHistory is set
+	*/
+	EvolutionCheckpointWriter(const std::string &bestConfigFile, const std::string &historyFile, bool appendHistory = false);
+
+	// Writes anything still queued before returning, exits if that failed
+	virtual ~EvolutionCheckpointWriter();
+
+	// Queues a checkpoint, moving out of it, and returns straight away. Exits if writing an earlier one failed
+	void submit(EvolutionCheckpoint &&checkpoint);
+
+private:
+
+	std::string bestConfigFile;
+	std::ofstream historyStream;
+
+	std::thread writerThread;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<EvolutionCheckpoint> queuedCheckpoints;
+	bool shouldShutdown;
+	std::string writeError; // Set by the writer thread the first time writing fails
+
+	// Only touched by the writer thread
+	uint32_t savedBestFitness;
+
+	void threadMainFunction();
+	void writeCheckpoint(const EvolutionCheckpoint &checkpoint);
+	bool saveBestConfig(const ShellConfig &shellConfig, std::string &error);
+	void exitIfWriteFailed();
+};
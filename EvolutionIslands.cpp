@@ -0,0 +1,324 @@
+#include "EvolutionIslands.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <JobSystemWorker.h>
+
+// At the start of the shared memory, the slots follow it
+struct EvolutionIslandsHeader
+{
+	std::atomic<uint64_t> layoutKey; // Set by the first island to attach, 0 until then
+};
+
+/*
+Followed by the migrants' words, each a fitness then its angles, stepper speeds and rim rotations, as 32 bit atomics so that
+reading them while they're written is only ever a stale read, caught by the sequence.
+*/
+struct EvolutionIslandSlotHeader
+{
+	std::atomic<uint64_t> sequence; // Odd while being written, 0 if nothing was sent since the island attached
+	std::atomic<uint32_t> generation;
+	std::atomic<uint32_t> migrantCount;
+	std::atomic<uint32_t> ownerProcess; // The attached island's process ID, 0 if it finished. Left behind if it crashed or was killed
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free, "Atomics shared between processes have to be lock free");
+
+static const size_t islandsCacheLineSize = 64;
+static const uint32_t islandsMaxReceiveAttempts = 64;
+static const uint32_t islandsMaxSizeWaitMilliseconds = 1000; // How long an island waits for the one creating the shared memory to size it
+
+static size_t alignToCacheLine(size_t size)
+{
+	return (size + islandsCacheLineSize - 1) / islandsCacheLineSize * islandsCacheLineSize;
+}
+
+// A slot is only used while the process that attached to it is running, so what a crashed or killed run left behind is ignored
+static bool isIslandProcessRunning(uint32_t process)
+{
+#ifdef __linux__
+	return process != 0 && (kill(pid_t(process), 0) == 0 || errno == EPERM);
+#else
+	return false;
+#endif
+}
+
+EvolutionIslands::EvolutionIslands(const std::string &nameValue, uint32_t islandIndexValue, uint32_t islandCountValue, uint32_t numAnglesValue, uint32_t migrantCountValue)
+{
+	name = nameValue;
+	islandIndex = islandIndexValue;
+	islandCount = islandCountValue;
+	numAngles = numAnglesValue;
+	migrantCount = migrantCountValue;
+
+	sharedMemory = nullptr;
+	slotSize = alignToCacheLine(sizeof(EvolutionIslandSlotHeader) + getMigrantWordCount() * migrantCount * sizeof(std::atomic<uint32_t>));
+	sharedMemorySize = alignToCacheLine(sizeof(EvolutionIslandsHeader)) + slotSize * islandCount;
+
+	lastReceivedSequence = 0;
+	lastReceivedOwner = 0;
+	receivedWords.resize(size_t(getMigrantWordCount()) * migrantCount);
+
+	if (islandIndex >= islandCount)
+	{
+		std::cout << "Island " << islandIndex << " doesn't exist, there are only " << islandCount << " islands" << std::endl;
+		exit(-1);
+	}
+
+#ifdef __linux__
+	// Only the island that creates the shared memory sizes it, as islands with different layouts racing to size it could leave
+	// one mapping more than it holds. New shared memory is zeroed, which is every slot unowned and no layout yet
+	int fileDescriptor = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	struct stat fileStatus;
+
+	if (fileDescriptor >= 0 && ftruncate(fileDescriptor, off_t(sharedMemorySize)) != 0)
+	{
+		shm_unlink(name.c_str());
+		std::cout << "Failed to size island shared memory: \"" << name << "\"" << std::endl;
+		exit(-1);
+	}
+	else if (fileDescriptor < 0 && errno == EEXIST)
+	{
+		fileDescriptor = shm_open(name.c_str(), O_RDWR, 0600);
+	}
+
+	if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0)
+	{
+		std::cout << "Failed to open island shared memory: \"" << name << "\"" << std::endl;
+		exit(-1);
+	}
+
+	// Another island may have just created it and not sized it yet
+	for (uint32_t i = 0; i < islandsMaxSizeWaitMilliseconds && fileStatus.st_size == 0; i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		if (fstat(fileDescriptor, &fileStatus) != 0)
+			break;
+	}
+
+	// Checked right before mapping it, mapping more than it holds would crash on the first access past its end
+	if (size_t(fileStatus.st_size) != sharedMemorySize)
+	{
+		std::cout << "Island shared memory: \"" << name << "\" is in use with a different number of islands, angles or migrants, remove /dev/shm" << name << " if it's left over" << std::endl;
+		exit(-1);
+	}
+
+	void *mappedMemory = mmap(nullptr, sharedMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+	close(fileDescriptor);
+
+	if (mappedMemory == MAP_FAILED)
+	{
+		std::cout << "Failed to map island shared memory: \"" << name << "\"" << std::endl;
+		exit(-1);
+	}
+
+	sharedMemory = (uint8_t*)mappedMemory;
+#else
+	std::cout << "Island mode needs POSIX shared memory, and is only supported on Linux" << std::endl;
+	exit(-1);
+#endif
+
+	EvolutionIslandsHeader *header = (EvolutionIslandsHeader*)sharedMemory;
+
+	// Never 0, that's no layout
+	const uint64_t layoutKey = (uint64_t(islandCount) << 48) ^ (uint64_t(numAngles) << 32) ^ migrantCount ^ 0x8000000000000000ull;
+	uint64_t expectedLayoutKey = 0;
+
+	if (!header->layoutKey.compare_exchange_strong(expectedLayoutKey, layoutKey) && expectedLayoutKey != layoutKey)
+	{
+		std::cout << "Island shared memory: \"" << name << "\" is in use with a different number of islands, angles or migrants, remove /dev/shm" << name << " if it's left over" << std::endl;
+		exit(-1);
+	}
+
+#ifdef __linux__
+	EvolutionIslandSlotHeader *ownSlotHeader = (EvolutionIslandSlotHeader*)getSlot(islandIndex);
+	uint32_t previousOwner = ownSlotHeader->ownerProcess.load(std::memory_order_acquire);
+
+	if (isIslandProcessRunning(previousOwner))
+	{
+		std::cout << "Island " << islandIndex << " is already running on island shared memory: \"" << name << "\" (process " << previousOwner << ")" << std::endl;
+		exit(-1);
+	}
+
+	// Whatever a previous run sent from this slot is gone before it's owned again, so it's never received as this run's
+	ownSlotHeader->sequence.store(0, std::memory_order_relaxed);
+
+	if (!ownSlotHeader->ownerProcess.compare_exchange_strong(previousOwner, uint32_t(getpid()), std::memory_order_release))
+	{
+		std::cout << "Island " << islandIndex << " is already running on island shared memory: \"" << name << "\"" << std::endl;
+		exit(-1);
+	}
+
+	uint32_t leftOverIslands = 0;
+
+	for (uint32_t i = 0; i < islandCount; i++)
+	{
+		const uint32_t owner = ((EvolutionIslandSlotHeader*)getSlot(i))->ownerProcess.load(std::memory_order_relaxed);
+
+		if (i != islandIndex && owner != 0 && !isIslandProcessRunning(owner))
+			leftOverIslands++;
+	}
+
+	if (leftOverIslands > 0)
+		std::cout << "Island shared memory: \"" << name << "\" has " << leftOverIslands << " islands left over from a run that didn't finish, their migrants are ignored until they're started again" << std::endl;
+#endif
+}
+
+EvolutionIslands::~EvolutionIslands()
+{
+#ifdef __linux__
+	((EvolutionIslandSlotHeader*)getSlot(islandIndex))->ownerProcess.store(0, std::memory_order_release);
+
+	// Removed by the last island still running, including after earlier runs crashed or were killed
+	bool lastIsland = true;
+
+	for (uint32_t i = 0; i < islandCount; i++)
+	{
+		if (isIslandProcessRunning(((EvolutionIslandSlotHeader*)getSlot(i))->ownerProcess.load(std::memory_order_acquire)))
+			lastIsland = false;
+	}
+
+	munmap(sharedMemory, sharedMemorySize);
+
+	if (lastIsland)
+		shm_unlink(name.c_str());
+#endif
+}
+
+uint32_t EvolutionIslands::getMigrantWordCount() const
+{
+	return 1 + numAngles * 3;
+}
+
+uint8_t *EvolutionIslands::getSlot(uint32_t island) const
+{
+	return sharedMemory + alignToCacheLine(sizeof(EvolutionIslandsHeader)) + slotSize * island;
+}
+
+void EvolutionIslands::sendMigrants(uint32_t generation, const PopulationGenomes &population, const uint64_t *ranking, uint32_t rankingSize)
+{
+	uint8_t *slot = getSlot(islandIndex);
+	EvolutionIslandSlotHeader *slotHeader = (EvolutionIslandSlotHeader*)slot;
+	std::atomic<uint32_t> *words = (std::atomic<uint32_t>*)(slot + sizeof(EvolutionIslandSlotHeader));
+
+	const uint32_t sentCount = std::min(migrantCount, rankingSize);
+	const uint64_t sequence = slotHeader->sequence.load(std::memory_order_relaxed);
+
+	// Odd while writing, the fence keeps the words from being written before it
+	slotHeader->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slotHeader->generation.store(generation, std::memory_order_relaxed);
+	slotHeader->migrantCount.store(sentCount, std::memory_order_relaxed);
+
+	for (uint32_t m = 0; m < sentCount; m++)
+	{
+		const uint32_t member = uint32_t(ranking[m]);
+		const size_t genesBegin = size_t(member) * numAngles;
+		std::atomic<uint32_t> *migrantWords = words + size_t(m) * getMigrantWordCount();
+
+		migrantWords[0].store(population.fitness[member], std::memory_order_relaxed);
+
+		for (uint32_t a = 0; a < numAngles; a++)
+		{
+			uint32_t geneWords[3];
+			memcpy(&geneWords[0], &population.shellArmAngles[genesBegin + a], sizeof(float));
+			memcpy(&geneWords[1], &population.shellStepperSpeed[genesBegin + a], sizeof(float));
+			memcpy(&geneWords[2], &population.rimRotationsUntilNextAngle[genesBegin + a], sizeof(float));
+
+			migrantWords[1 + a].store(geneWords[0], std::memory_order_relaxed);
+			migrantWords[1 + numAngles + a].store(geneWords[1], std::memory_order_relaxed);
+			migrantWords[1 + numAngles * 2 + a].store(geneWords[2], std::memory_order_relaxed);
+		}
+	}
+
+	slotHeader->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint32_t EvolutionIslands::receiveMigrants(PopulationGenomes &population, uint32_t maxReceivedCount)
+{
+	const uint32_t previousIsland = (islandIndex + islandCount - 1) % islandCount;
+
+	if (previousIsland == islandIndex)
+		return 0;
+
+	uint8_t *slot = getSlot(previousIsland);
+	EvolutionIslandSlotHeader *slotHeader = (EvolutionIslandSlotHeader*)slot;
+	std::atomic<uint32_t> *words = (std::atomic<uint32_t>*)(slot + sizeof(EvolutionIslandSlotHeader));
+
+	// The previous island isn't running (yet), anything in its slot is from a run that didn't finish
+	const uint32_t owner = slotHeader->ownerProcess.load(std::memory_order_acquire);
+
+	if (!isIslandProcessRunning(owner))
+		return 0;
+
+	uint32_t receivedCount = 0;
+	uint64_t sequence = 0;
+	bool consistent = false;
+
+	// Copies the slot out and keeps it only if no send started or finished in the meantime
+	for (uint32_t attempt = 0; attempt < islandsMaxReceiveAttempts && !consistent; attempt++)
+	{
+		sequence = slotHeader->sequence.load(std::memory_order_acquire);
+
+		// Nothing new, a restarted island starts its sequence over
+		if (sequence == 0 || (sequence == lastReceivedSequence && owner == lastReceivedOwner))
+			return 0;
+
+		if (sequence & 1)
+		{
+			jobSystemCpuRelax();
+			continue;
+		}
+
+		receivedCount = std::min(slotHeader->migrantCount.load(std::memory_order_relaxed), migrantCount);
+
+		for (size_t w = 0; w < size_t(receivedCount) * getMigrantWordCount(); w++)
+			receivedWords[w] = words[w].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		consistent = slotHeader->sequence.load(std::memory_order_relaxed) == sequence && slotHeader->ownerProcess.load(std::memory_order_relaxed) == owner;
+	}
+
+	// The previous island kept sending the whole time, try again next migration
+	if (!consistent)
+		return 0;
+
+	lastReceivedSequence = sequence;
+	lastReceivedOwner = owner;
+	receivedCount = std::min({ receivedCount, maxReceivedCount, population.memberCount });
+
+	// The last members are the random ones from natural selection, the least likely to be missed
+	for (uint32_t m = 0; m < receivedCount; m++)
+	{
+		const uint32_t member = population.memberCount - receivedCount + m;
+		const size_t genesBegin = size_t(member) * numAngles;
+		const uint32_t *migrantWords = &receivedWords[size_t(m) * getMigrantWordCount()];
+
+		population.fitness[member] = migrantWords[0];
+
+		for (uint32_t a = 0; a < numAngles; a++)
+		{
+			memcpy(&population.shellArmAngles[genesBegin + a], &migrantWords[1 + a], sizeof(float));
+			memcpy(&population.shellStepperSpeed[genesBegin + a], &migrantWords[1 + numAngles + a], sizeof(float));
+			memcpy(&population.rimRotationsUntilNextAngle[genesBegin + a], &migrantWords[1 + numAngles * 2 + a], sizeof(float));
+		}
+	}
+
+	return receivedCount;
+}
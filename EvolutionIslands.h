@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <EvolutionSimulation.h>
+
+/*
+Connects the islands of an island model search, separate processes each evolving their own population, which every so often
+send their best members on to the next island in a ring (island i to i + 1, the last to the first). Migrants keep islands from
+all converging on the same local minimum, without making them wait on each other.
+
+The islands share a POSIX shared memory object (Linux only), with a slot per island holding the members it last sent. Each
+slot has a single writer and is guarded by a seqlock, so sending never blocks, and receiving just retries (or gives up until
+next time) if it overlaps a send. Islands run at their own pace, so which generation's migrants an island receives isn't
+deterministic.
+
+The object is created by whichever island starts first and removed by the last to finish. Each slot records the process that
+owns it, so the slots of islands that crashed or were killed (e.g. with Ctrl-C) are ignored, and the object is still removed
+once none of them are running. Islands that don't agree on the number of islands, angles or migrants refuse to attach.
+*/
+class EvolutionIslands
+{
+public:
+
+	/*
+	@param[in] name The shared memory object's name, e.g. "/shell-islands", the same for every island
+	@param[in] migrantCount The max number of members sent at once
+	*/
+	EvolutionIslands(const std::string &name, uint32_t islandIndex, uint32_t islandCount, uint32_t numAngles, uint32_t migrantCount);
+	virtual ~EvolutionIslands();
+
+	// Sends the best migrantCount members, ranked as (fitness << 32 | member) best first, replacing whatever was sent before
+	void sendMigrants(uint32_t generation, const PopulationGenomes &population, const uint64_t *ranking, uint32_t rankingSize);
+
+	// Copies in the previous island's migrants if there are new ones, over at most the last maxReceivedCount members of
+	// population. Returns how many
+	uint32_t receiveMigrants(PopulationGenomes &population, uint32_t maxReceivedCount);
+
+private:
+
+	std::string name;
+	uint32_t islandIndex;
+	uint32_t islandCount;
+	uint32_t numAngles;
+	uint32_t migrantCount;
+
+	uint8_t *sharedMemory;
+	size_t sharedMemorySize;
+	size_t slotSize;
+
+	uint64_t lastReceivedSequence;
+	uint32_t lastReceivedOwner; // The previous island's process when lastReceivedSequence was received
+	std::vector<uint32_t> receivedWords; // A received slot's words, only used once they're known to be consistent
+
+	uint32_t getMigrantWordCount() const;
+	uint8_t *getSlot(uint32_t island) const;
+};
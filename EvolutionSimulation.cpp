@@ -1,18 +1,22 @@
 #include "EvolutionSimulation.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
-#include <fstream>
-#include <iomanip>
+#include <memory>
 
-#include <nlohmann/json.hpp>
 #include <JobSystem.h>
-
-using json = nlohmann::json;
+#include <FitnessCache.h>
+#include <PhiloxRandom.h>
+#include <EvolutionCheckpoint.h>
+#include <EvolutionSnapshot.h>
+#include <EvolutionIslands.h>
 
 EvolutionSimulation::EvolutionSimulation()
 {
-
+	currentPopulation = 0;
 }
 
 EvolutionSimulation::~EvolutionSimulation()
@@ -20,176 +24,299 @@ EvolutionSimulation::~EvolutionSimulation()
 
 }
 
-void EvolutionSimulation_evaluatePopulationFitnessJob(Job *job)
+void PopulationGenomes::resize(uint32_t memberCountValue, uint32_t numAnglesValue)
 {
-	EvolutionFitnessJobData &jobData = *reinterpret_cast<EvolutionFitnessJobData *>(job->usrData);
-	const float threadPopulationChunkSize = jobData.population->size() / float(JobSystem::get()->getWorkerCount());
- 
-	for (uint32_t i = uint32_t(threadPopulationChunkSize * jobData.threadNum); i < std::min<uint32_t>(uint32_t(threadPopulationChunkSize * (jobData.threadNum + 1)), jobData.population->size()); i++)
-	{
-		memset(jobData.layermap.data(), 0, jobData.layermap.size() * sizeof(jobData.layermap[0]));
-		memset(jobData.scratchLayermap.data(), 0, jobData.scratchLayermap.size() * sizeof(jobData.scratchLayermap[0]));
+	memberCount = memberCountValue;
+	numAngles = numAnglesValue;
 
-		jobData.simulator.simulateTaping((*jobData.population)[i].config, jobData.simConfig, jobData.layermap.data(), jobData.scratchLayermap.data());
-		(*jobData.population)[i].fitness = jobData.simulator.computeLayermapError(jobData.simConfig, jobData.evoConfig.targetLayers, jobData.layermap.data());
-	}
+	shellArmAngles.resize(size_t(memberCount) * numAngles);
+	shellStepperSpeed.resize(size_t(memberCount) * numAngles);
+	rimRotationsUntilNextAngle.resize(size_t(memberCount) * numAngles);
+	fitness.resize(memberCount);
+}
+
+void PopulationGenomes::getShellConfig(uint32_t member, const EvolutionConfig &evoConfig, ShellConfig &shellConfig) const
+{
+	const size_t genesBegin = size_t(member) * numAngles;
+
+	shellConfig.numAngles = numAngles;
+	shellConfig.shellDiameter = evoConfig.shellDiameter;
+	shellConfig.tapeWidth = evoConfig.tapeWidth;
+	shellConfig.shellChuckDiameter = evoConfig.shellChuckDiameter;
+
+	shellConfig.shellArmAngles.assign(shellArmAngles.begin() + genesBegin, shellArmAngles.begin() + genesBegin + numAngles);
+	shellConfig.shellStepperSpeed.assign(shellStepperSpeed.begin() + genesBegin, shellStepperSpeed.begin() + genesBegin + numAngles);
+	shellConfig.rimRotationsUntilNextAngle.assign(rimRotationsUntilNextAngle.begin() + genesBegin, rimRotationsUntilNextAngle.begin() + genesBegin + numAngles);
+}
+
+void PopulationGenomes::copyMember(uint32_t member, PopulationGenomes &destination, uint32_t destinationMember) const
+{
+	const size_t genesBegin = size_t(member) * numAngles;
+	const size_t destinationGenesBegin = size_t(destinationMember) * destination.numAngles;
+
+	std::copy_n(&shellArmAngles[genesBegin], numAngles, &destination.shellArmAngles[destinationGenesBegin]);
+	std::copy_n(&shellStepperSpeed[genesBegin], numAngles, &destination.shellStepperSpeed[destinationGenesBegin]);
+	std::copy_n(&rimRotationsUntilNextAngle[genesBegin], numAngles, &destination.rimRotationsUntilNextAngle[destinationGenesBegin]);
+	destination.fitness[destinationMember] = fitness[member];
 }
 
-void EvolutionSimulation::simulateEvolution(const SimulationConfig &simConfig, const EvolutionConfig &evoConfig)
+// "best-config.json" becomes "best-config-island2.json" on island 2, so islands sharing a directory don't overwrite each other
+static std::string getIslandFile(const std::string &file, const EvolutionConfig &evoConfig)
 {
-	std::vector<PopulationMember> population = initializePopulation(evoConfig);
+	if (evoConfig.islandCount <= 1)
+		return file;
 
-	std::vector<EvolutionFitnessJobData> jobsData;
+	const size_t extensionBegin = file.find_last_of('.');
+	const std::string islandSuffix = "-island" + std::to_string(evoConfig.islandIndex);
 
-	for (uint32_t t = 0; t < JobSystem::get()->getWorkerCount(); t++)
+	if (extensionBegin == std::string::npos || file.find_first_of("/\\", extensionBegin) != std::string::npos)
+		return file + islandSuffix;
+
+	return file.substr(0, extensionBegin) + islandSuffix + file.substr(extensionBegin);
+}
+
+void EvolutionSimulation::simulateEvolution(const SimulationConfig &simConfig, const EvolutionConfig &evoConfig, const std::string &resumeFile)
+{
+	populations[0].resize(evoConfig.populationSize, evoConfig.numAngles);
+	populations[1].resize(evoConfig.populationSize, evoConfig.numAngles);
+	fitnessRanking.resize(evoConfig.populationSize);
+	fitnessKeys.resize(evoConfig.populationSize);
+	fitnessesToCache.resize(evoConfig.populationSize);
+	currentPopulation = 0;
+
+	FitnessCache fitnessCache(evoConfig.fitnessCacheEntries);
+
+	// Members whose fitness is guaranteed to be above this stop simulating early (see ShellSimulation::simulateTapingError())
+	uint32_t fitnessCutoff = UINT32_MAX;
+	uint32_t firstGeneration = 0;
+
+	EvolutionSnapshotLayout snapshotLayout = {};
+	snapshotLayout.populationSize = evoConfig.populationSize;
+	snapshotLayout.numAngles = evoConfig.numAngles;
+	snapshotLayout.fitnessCacheEntryCount = fitnessCache.getEntryCount();
+	snapshotLayout.randomSeed = evoConfig.randomSeed;
+
+	if (resumeFile.empty())
+	{
+		initializePopulation(populations[currentPopulation], evoConfig);
+	}
+	else
 	{
-		EvolutionFitnessJobData jobData = {};
-		jobData.population = &population;
-		jobData.simConfig = simConfig;
-		jobData.evoConfig = evoConfig;
-		jobData.threadNum = t;
-		jobData.layermap = std::vector<uint16_t>(simConfig.layermapSize * simConfig.layermapSize);
-		jobData.scratchLayermap = std::vector<uint16_t>(simConfig.layermapSize * simConfig.layermapSize);
-
-		jobsData.push_back(jobData);
+		if (!loadEvolutionSnapshot(resumeFile, snapshotLayout, firstGeneration, fitnessCutoff, populations[currentPopulation], fitnessCache))
+			exit(-1);
+
+		std::cout << "Resuming from generation " << firstGeneration << " of \"" << resumeFile << "\"" << std::endl;
 	}
 
-	for (uint32_t g = 0; g < evoConfig.maxGenerations; g++)
+	// Only created once a snapshot's been resumed from, as it may be the same file
+	std::unique_ptr<EvolutionSnapshotWriter> snapshotWriter;
+
+	if (evoConfig.snapshotInterval > 0)
+		snapshotWriter.reset(new EvolutionSnapshotWriter(getIslandFile(evoConfig.snapshotFile, evoConfig), snapshotLayout));
+
+	std::unique_ptr<EvolutionIslands> islands;
+
+	if (evoConfig.islandCount > 1)
 	{
-		std::vector<Job *> jobs;
+		islands.reset(new EvolutionIslands(evoConfig.islandName, evoConfig.islandIndex, evoConfig.islandCount, evoConfig.numAngles, evoConfig.migrantCount));
+		std::cout << "Evolving island " << evoConfig.islandIndex << " of " << evoConfig.islandCount << ", migrating every " << evoConfig.migrationInterval << " generations" << std::endl;
+	}
 
-		for (uint32_t t = 0; t < JobSystem::get()->getWorkerCount(); t++)
-		{
-			jobs.push_back(JobSystem::get()->allocateJob(&EvolutionSimulation_evaluatePopulationFitnessJob));
-			jobs.back()->usrData = reinterpret_cast<void *>(&jobsData[t]);
-		}
+	// One per JobSystem worker, created by the worker itself the first time it evaluates a member, along with the config members are unpacked into
+	std::vector<std::unique_ptr<ShellSimulation>> workerSimulators(JobSystem::get()->getWorkerCount());
+	std::vector<ShellConfig> workerShellConfigs(JobSystem::get()->getWorkerCount());
 
-		JobSystem::get()->runJobs(jobs);
+	// Results go to disk and the console on their own thread, off the path between generations
+	EvolutionCheckpointWriter checkpointWriter(getIslandFile("best-config.json", evoConfig), getIslandFile("evolution-history.ndjson", evoConfig), !resumeFile.empty());
+
+	for (uint32_t g = firstGeneration; g < evoConfig.maxGenerations; g++)
+	{
+		const auto generationStartTime = std::chrono::steady_clock::now();
 
-		for (size_t j = 0; j < jobs.size(); j++)
-			JobSystem::get()->waitForJob(jobs[j], true);
+		PopulationGenomes &population = populations[currentPopulation];
 
-		// Sort smallest to largest
-		std::sort(population.begin(), population.end(), [](const PopulationMember &first, const PopulationMember &second)
+		// Members vary a lot in how long they take to simulate, so the population is split up as finely as there are idle workers
+		JobSystem::get()->parallelFor(0, evoConfig.populationSize, 1, [&](uint32_t populationBegin, uint32_t populationEnd)
 			{
-				return first.fitness < second.fitness;
+				const uint32_t workerIndex = JobSystem::get()->getCurrentWorkerIndex();
+				std::unique_ptr<ShellSimulation> &workerSimulator = workerSimulators[workerIndex];
+				ShellConfig &memberConfig = workerShellConfigs[workerIndex];
+
+				if (workerSimulator == nullptr)
+					workerSimulator.reset(new ShellSimulation());
+
+				for (uint32_t i = populationBegin; i < populationEnd; i++)
+				{
+					population.getShellConfig(i, evoConfig, memberConfig);
+					fitnessKeys[i] = FitnessCache::computeKey(memberConfig, simConfig, evoConfig.targetLayers);
+					fitnessesToCache[i] = 0;
+
+					if (fitnessCache.find(fitnessKeys[i], population.fitness[i]))
+						continue;
+
+					// Only the error is needed, so the full layermap is never built. A fitness cut off early is still cached, as the cutoff only ever decreases
+					population.fitness[i] = workerSimulator->simulateTapingError(memberConfig, simConfig, evoConfig.targetLayers, fitnessCutoff);
+					fitnessesToCache[i] = 1;
+				}
 			});
 
-		json shellConfigJSON;
-		shellConfigJSON["numAngles"] = population[0].config.numAngles;
-		shellConfigJSON["shellDiameter"] = population[0].config.shellDiameter;
-		shellConfigJSON["tapeWidth"] = population[0].config.tapeWidth;
-		shellConfigJSON["shellChuckDiameter"] = population[0].config.shellChuckDiameter;
-		shellConfigJSON["shellArmAngles"] = population[0].config.shellArmAngles;
+		// The cache is only added to here, in member order, so what's in it (and so every fitness) doesn't depend on how the jobs were scheduled
+		for (uint32_t i = 0; i < evoConfig.populationSize; i++)
+		{
+			if (fitnessesToCache[i])
+				fitnessCache.insert(fitnessKeys[i], population.fitness[i]);
+		}
+
+		// Find the best, smallest to largest
+		rankPopulation(population, evoConfig);
 
-		std::vector<float> shellStepperSpeedFraction;
+		const uint32_t bestMember = uint32_t(fitnessRanking[0]);
 
-		for (uint32_t a = 0; a < population[0].config.numAngles; a++)
-			shellStepperSpeedFraction.push_back(0.5f / population[0].config.shellStepperSpeed[a]);
+		EvolutionCheckpoint checkpoint;
+		checkpoint.generation = g;
+		checkpoint.bestFitness = population.fitness[bestMember];
+		checkpoint.generationMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generationStartTime).count();
+		fitnessCache.takeStatistics(checkpoint.fitnessCacheHits, checkpoint.fitnessCacheMisses);
+		JobSystem::get()->takeStealStatistics(checkpoint.stealAttempts, checkpoint.stealSuccesses, checkpoint.stolenJobs);
+		population.getShellConfig(bestMember, evoConfig, checkpoint.bestShellConfig);
+		checkpoint.receivedMigrants = 0;
 
-		shellConfigJSON["shellStepperSpeedFraction"] = shellStepperSpeedFraction;
-		shellConfigJSON["rimRotationsUntilNextAngle"] = shellStepperSpeedFraction;
+		// Anything worse than the worst of the elite won't survive into the next generation, so it doesn't need an exact fitness
+		const uint32_t eliteCount = uint32_t(evoConfig.populationSize * evoConfig.elitePercentage);
 
-		std::ofstream lowestErrorResultFile("best-config.json");
+		fitnessCutoff = eliteCount > 0 ? uint32_t(fitnessRanking[std::min<size_t>(eliteCount, fitnessRanking.size()) - 1] >> 32) : UINT32_MAX;
 
-		if (!lowestErrorResultFile.is_open())
+		simulateNaturalSelection(population, populations[1 - currentPopulation], g, evoConfig);
+
+		if (islands != nullptr && evoConfig.migrationInterval > 0 && (g + 1) % evoConfig.migrationInterval == 0)
 		{
-			std::cout << "Failed to open file stream for output file: \"" << "best-config.json" << "\" to write results of simulation!" << std::endl;
-			exit(-1);
+			// Only the random members are replaced, never the elite or children
+			islands->sendMigrants(g, population, fitnessRanking.data(), evoConfig.populationSize);
+			checkpoint.receivedMigrants = islands->receiveMigrants(populations[1 - currentPopulation], uint32_t(evoConfig.populationSize * evoConfig.randomPercentage));
 		}
 
-		lowestErrorResultFile << std::setw(4) << shellConfigJSON << std::endl;
-		lowestErrorResultFile.close();
-
-		std::cout << "Generation " << g << ", best fitness: " << population[0].fitness << ", saved to \"best-config.json\"" << std::endl;
+		checkpointWriter.submit(std::move(checkpoint));
+		currentPopulation = 1 - currentPopulation;
 
-		simulateNaturalSelection(population, evoConfig);
+		// The snapshot is of the next generation before it's evaluated, the last one so a finished run can be extended
+		if (snapshotWriter != nullptr && ((g + 1) % evoConfig.snapshotInterval == 0 || g + 1 == evoConfig.maxGenerations))
+			snapshotWriter->submit(g + 1, fitnessCutoff, populations[currentPopulation], fitnessCache);
 	}
 }
 
-void EvolutionSimulation::simulateNaturalSelection(std::vector<PopulationMember> &population, const EvolutionConfig &evoConfig)
+void EvolutionSimulation::rankPopulation(const PopulationGenomes &population, const EvolutionConfig &evoConfig)
 {
-	uint32_t eliteCount = uint32_t(evoConfig.populationSize * evoConfig.elitePercentage);
-	uint32_t randomCount = uint32_t(evoConfig.populationSize * evoConfig.randomPercentage);
-
-	// Kill off the last "randomPercentage" and replace them with random members to keep the gene pool interesting
-	EvolutionConfig randomPopulationConfig = evoConfig;
-	randomPopulationConfig.populationSize = randomCount;
-	std::vector<PopulationMember> randomPopulation = initializePopulation(randomPopulationConfig);
-
-	// Kill off the middle percentage and replace them with children
-	std::vector<PopulationMember> children;
+	const uint32_t eliteCount = uint32_t(evoConfig.populationSize * evoConfig.elitePercentage);
+	const uint32_t randomCount = uint32_t(evoConfig.populationSize * evoConfig.randomPercentage);
+	const uint32_t breedingPoolSize = population.memberCount - randomCount;
+
+	// The best member is always ranked, even if there's no elite or breeding pool, and so are the migrants sent to the next island
+	const uint32_t migrantCount = evoConfig.islandCount > 1 ? evoConfig.migrantCount : 0;
+	const uint32_t sortedCount = std::min(std::max({ eliteCount, migrantCount, 1u }), population.memberCount);
+	const uint32_t partitionedCount = std::max(breedingPoolSize, sortedCount);
+
+	// Ranking packed (fitness, member) keys rather than the members themselves, ties go to the lower member
+	for (uint32_t i = 0; i < population.memberCount; i++)
+		fitnessRanking[i] = (uint64_t(population.fitness[i]) << 32) | i;
+
+	// Parents are picked at random from the breeding pool, so only the elite, migrants and the best have to actually be in order
+	std::nth_element(fitnessRanking.begin(), fitnessRanking.begin() + partitionedCount, fitnessRanking.end());
+	std::nth_element(fitnessRanking.begin(), fitnessRanking.begin() + sortedCount, fitnessRanking.begin() + partitionedCount);
+	std::sort(fitnessRanking.begin(), fitnessRanking.begin() + sortedCount);
+}
 
-	for (uint32_t c = 0; c < evoConfig.populationSize - eliteCount - randomCount; c++)
-		children.push_back(breedPopulationMembers(population[rand() % (evoConfig.populationSize - randomCount)], population[rand() % (evoConfig.populationSize - randomCount)], evoConfig));
+void EvolutionSimulation::simulateNaturalSelection(const PopulationGenomes &population, PopulationGenomes &nextPopulation, uint32_t generation, const EvolutionConfig &evoConfig)
+{
+	const uint32_t eliteCount = uint32_t(evoConfig.populationSize * evoConfig.elitePercentage);
+	const uint32_t randomCount = uint32_t(evoConfig.populationSize * evoConfig.randomPercentage);
+	const uint32_t childCount = evoConfig.populationSize - eliteCount - randomCount;
 
-	// Replace the old population with the new members (excluding the elite)
-	population.erase(population.begin() + eliteCount, population.end());
-	population.insert(population.end(), children.begin(), children.end());
-	population.insert(population.end(), randomPopulation.begin(), randomPopulation.end());
+	// Every member of the next generation only depends on this one, and draws its random numbers from its own stream
+	JobSystem::get()->parallelFor(0, evoConfig.populationSize, 0, [&](uint32_t memberBegin, uint32_t memberEnd)
+		{
+			for (uint32_t m = memberBegin; m < memberEnd; m++)
+			{
+				if (m < eliteCount)
+				{
+					// Keep the elite
+					population.copyMember(uint32_t(fitnessRanking[m]), nextPopulation, m);
+				}
+				else if (m < eliteCount + childCount)
+				{
+					// Kill off the middle percentage and replace them with children
+					PhiloxRandom random(evoConfig.randomSeed, generation, m);
+
+					const uint32_t first = uint32_t(fitnessRanking[random.next() % (evoConfig.populationSize - randomCount)]);
+					const uint32_t second = uint32_t(fitnessRanking[random.next() % (evoConfig.populationSize - randomCount)]);
+
+					breedPopulationMembers(population, first, second, nextPopulation, m, random, evoConfig);
+				}
+				else
+				{
+					// Kill off the last "randomPercentage" and replace them with random members to keep the gene pool interesting
+					initializePopulationMember(nextPopulation, m, m - eliteCount - childCount, randomCount, evoConfig);
+				}
+			}
+		});
 }
 
-PopulationMember EvolutionSimulation::breedPopulationMembers(const PopulationMember &first, const PopulationMember &second, const EvolutionConfig &evoConfig)
+void EvolutionSimulation::breedPopulationMembers(const PopulationGenomes &population, uint32_t first, uint32_t second, PopulationGenomes &nextPopulation, uint32_t child, PhiloxRandom &random, const EvolutionConfig &evoConfig)
 {
-	PopulationMember member = {};
-	member.fitness = 0;
-	member.config.numAngles = evoConfig.numAngles;
-	member.config.shellDiameter = evoConfig.shellDiameter;
-	member.config.tapeWidth = evoConfig.tapeWidth;
-	member.config.shellChuckDiameter = evoConfig.shellChuckDiameter;
-
-	for (uint32_t a = 0; a < member.config.numAngles; a++)
+	const float *firstArmAngles = &population.shellArmAngles[size_t(first) * population.numAngles];
+	const float *secondArmAngles = &population.shellArmAngles[size_t(second) * population.numAngles];
+	const float *firstStepperSpeeds = &population.shellStepperSpeed[size_t(first) * population.numAngles];
+	const float *secondStepperSpeeds = &population.shellStepperSpeed[size_t(second) * population.numAngles];
+
+	float *childArmAngles = &nextPopulation.shellArmAngles[size_t(child) * nextPopulation.numAngles];
+	float *childStepperSpeeds = &nextPopulation.shellStepperSpeed[size_t(child) * nextPopulation.numAngles];
+	float *childRimRotations = &nextPopulation.rimRotationsUntilNextAngle[size_t(child) * nextPopulation.numAngles];
+
+	nextPopulation.fitness[child] = 0;
+
+	for (uint32_t a = 0; a < nextPopulation.numAngles; a++)
 	{
 		// Breed angle and speed, it may technically be more correct to pick the gene of ONE parent, but for this application it may be better to randomly lerp between parents
-		float angleLerp = rand() / float(RAND_MAX);
-		float speedLerp = rand() / float(RAND_MAX);
-		float bredAngle = first.config.shellArmAngles[a] * (1.0f - angleLerp) + second.config.shellArmAngles[a] * angleLerp;
-		float bredSpeed = first.config.shellStepperSpeed[a] * (1.0f - speedLerp) + second.config.shellStepperSpeed[a] * speedLerp;
+		float angleLerp = random.nextFloat();
+		float speedLerp = random.nextFloat();
+		float bredAngle = firstArmAngles[a] * (1.0f - angleLerp) + secondArmAngles[a] * angleLerp;
+		float bredSpeed = firstStepperSpeeds[a] * (1.0f - speedLerp) + secondStepperSpeeds[a] * speedLerp;
 
 		// Mutate the angle and speed a little
-		bredAngle *= 1.0f + evoConfig.maxMutationPercentage * (rand() % 10 < 5 ? 1.0f : -1.0f) * (rand() / float(RAND_MAX));
-		bredSpeed *= 1.0f + evoConfig.maxMutationPercentage * (rand() % 10 < 5 ? 1.0f : -1.0f) * (rand() / float(RAND_MAX));
+		bredAngle *= 1.0f + evoConfig.maxMutationPercentage * (random.next() % 10 < 5 ? 1.0f : -1.0f) * random.nextFloat();
+		bredSpeed *= 1.0f + evoConfig.maxMutationPercentage * (random.next() % 10 < 5 ? 1.0f : -1.0f) * random.nextFloat();
 
 		// Keep the angle within the physical limits
 		bredAngle = std::max(std::min(bredAngle, 90.0f), evoConfig.minShellArmAngle);
 
-		member.config.shellArmAngles.push_back(bredAngle);
-		member.config.shellStepperSpeed.push_back(bredSpeed);
-		member.config.rimRotationsUntilNextAngle.push_back(1.0f / bredSpeed);
+		childArmAngles[a] = bredAngle;
+		childStepperSpeeds[a] = bredSpeed;
+		childRimRotations[a] = 1.0f / bredSpeed;
 	}
+}
 
-	return member;
+void EvolutionSimulation::initializePopulation(PopulationGenomes &population, const EvolutionConfig &evoConfig)
+{
+	for (uint32_t i = 0; i < population.memberCount; i++)
+		initializePopulationMember(population, i, i, population.memberCount, evoConfig);
 }
 
-std::vector<PopulationMember> EvolutionSimulation::initializePopulation(const EvolutionConfig &evoConfig)
+void EvolutionSimulation::initializePopulationMember(PopulationGenomes &population, uint32_t member, uint32_t gridIndex, uint32_t gridSize, const EvolutionConfig &evoConfig)
 {
-	std::vector<PopulationMember> population(evoConfig.populationSize);
-	uint32_t populationSizeSqrt = uint32_t(std::sqrt(evoConfig.populationSize));
+	// Members are spread over a grid of angles and speeds
+	uint32_t populationSizeSqrt = uint32_t(std::sqrt(gridSize));
+	const size_t genesBegin = size_t(member) * population.numAngles;
 
-	for (uint32_t i = 0; i < evoConfig.populationSize; i++)
+	for (uint32_t a = 0; a < population.numAngles; a++)
 	{
-		ShellConfig shellConfig = {};
-		shellConfig.numAngles = evoConfig.numAngles;
-		shellConfig.shellDiameter = evoConfig.shellDiameter;
-		shellConfig.tapeWidth = evoConfig.tapeWidth;
-		shellConfig.shellChuckDiameter = evoConfig.shellChuckDiameter;
-
-		for (uint32_t a = 0; a < shellConfig.numAngles; a++)
-		{
-			float lerpFactor = float(i % populationSizeSqrt) / float(populationSizeSqrt - 1);
-			float speedLerpFactor = float(i / populationSizeSqrt) / float(populationSizeSqrt);
-			float angle = evoConfig.minShellArmAngles[a] * (1.0f - lerpFactor) + evoConfig.maxShellArmAngles[a] * lerpFactor;
-			float speed = evoConfig.minShellStepperSpeed[a] * (1.0f - speedLerpFactor) + evoConfig.maxShellStepperSpeed[a] * speedLerpFactor;
-
-			shellConfig.shellArmAngles.push_back(angle);
-			shellConfig.shellStepperSpeed.push_back((1.0f / speed) * 0.5f);
-			shellConfig.rimRotationsUntilNextAngle.push_back((speed) * 0.5f);
-		}
-
-		PopulationMember &member = population[i];
-		member.config = shellConfig;
-		member.fitness = 0;
+		float lerpFactor = float(gridIndex % populationSizeSqrt) / float(populationSizeSqrt - 1);
+		float speedLerpFactor = float(gridIndex / populationSizeSqrt) / float(populationSizeSqrt);
+		float angle = evoConfig.minShellArmAngles[a] * (1.0f - lerpFactor) + evoConfig.maxShellArmAngles[a] * lerpFactor;
+		float speed = evoConfig.minShellStepperSpeed[a] * (1.0f - speedLerpFactor) + evoConfig.maxShellStepperSpeed[a] * speedLerpFactor;
+
+		population.shellArmAngles[genesBegin + a] = angle;
+		population.shellStepperSpeed[genesBegin + a] = (1.0f / speed) * 0.5f;
+		population.rimRotationsUntilNextAngle[genesBegin + a] = (speed) * 0.5f;
 	}
 
-	return population;
+	population.fitness[member] = 0;
 }
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include <ShellSimulation.h>
 
+class PhiloxRandom;
+
 struct EvolutionConfig
 {
 	uint32_t numAngles; // Number of angles/applications per taping session
@@ -19,6 +22,17 @@ struct EvolutionConfig
 	float randomPercentage; // The percentage each generation that is filled with a random genome, to keep the gene pool fresh
 	float maxMutationPercentage; // The max percentage to mutate each gene in a population member when reproducing
 	float minShellArmAngle; // The minimum angle physically allowed
+	uint32_t fitnessCacheEntries; // The max number of fitnesses to remember, so that (nearly) identical genomes aren't simulated again
+	uint64_t randomSeed; // A search is reproducible for a given seed, no matter how many workers run it
+	uint32_t snapshotInterval; // The number of generations between population snapshots to resume from, 0 for none
+	std::string snapshotFile; // Where population snapshots are written
+
+	// Island mode, where islandCount processes each evolve a population and pass on their best members (see EvolutionIslands)
+	uint32_t islandCount; // 1 for a single population
+	uint32_t islandIndex;
+	std::string islandName; // The name of the shared memory the islands migrate through
+	uint32_t migrationInterval; // The number of generations between migrations
+	uint32_t migrantCount; // The number of best members sent to the next island each migration
 
 	// The min and max angles per application that will be searched
 	std::vector<float> minShellArmAngles;
@@ -29,20 +43,27 @@ struct EvolutionConfig
 	std::vector<float> maxShellStepperSpeed;
 };
 
-struct PopulationMember
+/*
+The genomes of a whole population as a structure of arrays, each gene of every member in one contiguous array (member by member,
+numAngles genes each), so a generation can be bred into another without any allocations once they're sized.
+*/
+struct PopulationGenomes
 {
-	ShellConfig config;
-	uint32_t fitness;
-};
+	uint32_t memberCount;
+	uint32_t numAngles;
 
-struct EvolutionFitnessJobData
-{
-	ShellSimulation simulator;
-	std::vector<PopulationMember> *population;
-	SimulationConfig simConfig;
-	EvolutionConfig evoConfig;
-	uint32_t threadNum;
-	std::vector<uint16_t> layermap, scratchLayermap;
+	std::vector<float> shellArmAngles;
+	std::vector<float> shellStepperSpeed;
+	std::vector<float> rimRotationsUntilNextAngle;
+	std::vector<uint32_t> fitness;
+
+	// Only reallocates if the size changed
+	void resize(uint32_t memberCountValue, uint32_t numAnglesValue);
+
+	// Writes a member's genes into shellConfig, reusing its vectors' memory
+	void getShellConfig(uint32_t member, const EvolutionConfig &evoConfig, ShellConfig &shellConfig) const;
+
+	void copyMember(uint32_t member, PopulationGenomes &destination, uint32_t destinationMember) const;
 };
 
 class EvolutionSimulation
@@ -55,13 +76,26 @@ public:
 	/*
 	Simulates a population's evolution to find the optimal settings/config for the parameters specified. Writes the best
 	to a specified output file.
+
+	@param[in] resumeFile If not empty, a population snapshot to continue from instead of starting over
 	*/
-	void simulateEvolution(const SimulationConfig &simConfig, const EvolutionConfig &evoConfig);
+	void simulateEvolution(const SimulationConfig &simConfig, const EvolutionConfig &evoConfig, const std::string &resumeFile = "");
 
 private:
-	std::vector<PopulationMember> initializePopulation(const EvolutionConfig &evoConfig);
-	void simulateNaturalSelection(std::vector<PopulationMember> &population, const EvolutionConfig &evoConfig);
-	PopulationMember breedPopulationMembers(const PopulationMember &first, const PopulationMember &second, const EvolutionConfig &evoConfig);
+
+	// Double buffered, each generation is bred from populations[currentPopulation] into the other
+	PopulationGenomes populations[2];
+	uint32_t currentPopulation;
+
+	std::vector<uint64_t> fitnessRanking; // (fitness << 32 | member) of each member, the elite sorted best first, then the rest of the breeding pool, then the rest
+	std::vector<uint64_t> fitnessKeys; // Each member's FitnessCache key
+	std::vector<uint8_t> fitnessesToCache; // Whether each member's fitness was simulated this generation, and should be added to the cache
+
+	void initializePopulation(PopulationGenomes &population, const EvolutionConfig &evoConfig);
+	void initializePopulationMember(PopulationGenomes &population, uint32_t member, uint32_t gridIndex, uint32_t gridSize, const EvolutionConfig &evoConfig);
+	void rankPopulation(const PopulationGenomes &population, const EvolutionConfig &evoConfig);
+	void simulateNaturalSelection(const PopulationGenomes &population, PopulationGenomes &nextPopulation, uint32_t generation, const EvolutionConfig &evoConfig);
+	void breedPopulationMembers(const PopulationGenomes &population, uint32_t first, uint32_t second, PopulationGenomes &nextPopulation, uint32_t child, PhiloxRandom &random, const EvolutionConfig &evoConfig);
 	
 };
 
@@ -0,0 +1,448 @@
+#include "EvolutionSnapshot.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char snapshotMagic[8] = { 'S', 'H', 'E', 'L', 'L', 'E', 'V', 'O' };
+static const uint32_t snapshotVersion = 1;
+
+struct EvolutionSnapshotFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t blockSize;
+	EvolutionSnapshotLayout layout;
+	uint64_t dataSize;
+};
+
+struct EvolutionSnapshotSlotHeader
+{
+	uint64_t sequence; // Increases with each snapshot, 0 if the slot was never written
+	uint32_t generation;
+	uint32_t fitnessCutoff;
+	uint64_t dataChecksum;
+	uint64_t headerChecksum; // Of everything above
+};
+
+// FNV-1a
+static uint64_t computeChecksum(const void *data, uint64_t size, uint64_t checksum = 0xCBF29CE484222325ull)
+{
+	const uint8_t *bytes = (const uint8_t*)data;
+
+	for (uint64_t i = 0; i < size; i++)
+		checksum = (checksum ^ bytes[i]) * 0x100000001B3ull;
+
+	return checksum;
+}
+
+static uint64_t computeSlotHeaderChecksum(const EvolutionSnapshotSlotHeader &slotHeader)
+{
+	return computeChecksum(&slotHeader, offsetof(EvolutionSnapshotSlotHeader, headerChecksum));
+}
+
+/*
+The data of a snapshot, the fitness cache entries first so they're 8 byte aligned, then each gene array and the fitnesses, as
+laid out in PopulationGenomes.
+*/
+static uint64_t getSnapshotDataSize(const EvolutionSnapshotLayout &layout)
+{
+	const uint64_t geneCount = uint64_t(layout.populationSize) * layout.numAngles;
+
+	return layout.fitnessCacheEntryCount * sizeof(uint64_t) + geneCount * sizeof(float) * 3 + uint64_t(layout.populationSize) * sizeof(uint32_t);
+}
+
+static EvolutionSnapshotFileHeader createFileHeader(const EvolutionSnapshotLayout &layout)
+{
+	EvolutionSnapshotFileHeader fileHeader;
+	memset(&fileHeader, 0, sizeof(fileHeader));
+	memcpy(fileHeader.magic, snapshotMagic, sizeof(snapshotMagic));
+	fileHeader.version = snapshotVersion;
+	fileHeader.blockSize = EvolutionSnapshotWriter::blockSize;
+	fileHeader.layout = layout;
+	fileHeader.dataSize = getSnapshotDataSize(layout);
+
+	return fileHeader;
+}
+
+// Each slot is a block for its header, then the data rounded up to whole blocks. The file header gets the first block
+static uint64_t getSlotSize(uint64_t dataSize)
+{
+	const uint64_t blockSize = EvolutionSnapshotWriter::blockSize;
+
+	return blockSize + (dataSize + blockSize - 1) / blockSize * blockSize;
+}
+
+static uint64_t getSlotOffset(uint32_t slot, uint64_t slotSize)
+{
+	return EvolutionSnapshotWriter::blockSize + slot * slotSize;
+}
+
+EvolutionSnapshotWriter::EvolutionSnapshotWriter(const std::string &fileValue, const EvolutionSnapshotLayout &layoutValue)
+{
+	file = fileValue;
+	layout = layoutValue;
+	dataSize = getSnapshotDataSize(layout);
+	slotSize = getSlotSize(dataSize);
+
+	hasPendingSnapshot = false;
+	shouldShutdown = false;
+	pendingGeneration = 0;
+	pendingFitnessCutoff = 0;
+	lastSequence = 0;
+
+#ifdef __linux__
+	fileDescriptor = open(file.c_str(), O_RDWR | O_CREAT, 0644);
+
+	if (fileDescriptor < 0)
+#else
+	// Creates the file if it doesn't exist, without truncating it if it does
+	std::ofstream(file, std::ios::binary | std::ios::app).close();
+	fileStream.open(file, std::ios::binary | std::ios::in | std::ios::out);
+
+	if (!fileStream.is_open())
+#endif
+	{
+		std::cout << "Failed to open population snapshot file: \"" << file << "\"" << std::endl;
+		exit(-1);
+	}
+
+	const EvolutionSnapshotFileHeader fileHeader = createFileHeader(layout);
+	EvolutionSnapshotFileHeader existingFileHeader;
+	memset(&existingFileHeader, 0, sizeof(existingFileHeader));
+
+	readFile(0, &existingFileHeader, sizeof(existingFileHeader));
+
+	if (memcmp(&fileHeader, &existingFileHeader, sizeof(fileHeader)) == 0)
+	{
+		// Keep counting from the newest snapshot in the file, so the next one goes in the other slot
+		for (uint32_t slot = 0; slot < 2; slot++)
+		{
+			EvolutionSnapshotSlotHeader slotHeader;
+			memset(&slotHeader, 0, sizeof(slotHeader));
+
+			readFile(getSlotOffset(slot, slotSize), &slotHeader, sizeof(slotHeader));
+
+			if (slotHeader.headerChecksum == computeSlotHeaderChecksum(slotHeader))
+				lastSequence = std::max(lastSequence, slotHeader.sequence);
+		}
+	}
+	else
+	{
+		// Clear both slot headers before the file header says they can be read
+		const EvolutionSnapshotSlotHeader emptySlotHeader = {};
+
+		if (!writeFile(getSlotOffset(0, slotSize), &emptySlotHeader, sizeof(emptySlotHeader)) || !writeFile(getSlotOffset(1, slotSize), &emptySlotHeader, sizeof(emptySlotHeader))
+			|| !syncFile() || !writeFile(0, &fileHeader, sizeof(fileHeader)) || !syncFile())
+		{
+			std::cout << "Failed to write population snapshot file: \"" << file << "\"" << std::endl;
+			exit(-1);
+		}
+	}
+
+	writerThread = std::thread(&EvolutionSnapshotWriter::threadMainFunction, this);
+}
+
+EvolutionSnapshotWriter::~EvolutionSnapshotWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		shouldShutdown = true;
+	}
+
+	pendingCondition.notify_one();
+	writerThread.join();
+
+#ifdef __linux__
+	close(fileDescriptor);
+#else
+	fileStream.close();
+#endif
+
+	exitIfWriteFailed();
+}
+
+void EvolutionSnapshotWriter::submit(uint32_t generation, uint32_t fitnessCutoff, const PopulationGenomes &population, const FitnessCache &fitnessCache)
+{
+	exitIfWriteFailed();
+
+	submitData.resize(dataSize);
+
+	const size_t geneCount = size_t(population.memberCount) * population.numAngles;
+	uint8_t *data = submitData.data();
+
+	fitnessCache.saveEntries((uint64_t*)data);
+	data += fitnessCache.getEntryCount() * sizeof(uint64_t);
+
+	memcpy(data, population.shellArmAngles.data(), geneCount * sizeof(float));
+	data += geneCount * sizeof(float);
+	memcpy(data, population.shellStepperSpeed.data(), geneCount * sizeof(float));
+	data += geneCount * sizeof(float);
+	memcpy(data, population.rimRotationsUntilNextAngle.data(), geneCount * sizeof(float));
+	data += geneCount * sizeof(float);
+	memcpy(data, population.fitness.data(), population.memberCount * sizeof(uint32_t));
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+
+		// Replaces the pending snapshot if the last one hasn't been picked up yet
+		std::swap(submitData, pendingData);
+		pendingGeneration = generation;
+		pendingFitnessCutoff = fitnessCutoff;
+		hasPendingSnapshot = true;
+	}
+
+	pendingCondition.notify_one();
+}
+
+void EvolutionSnapshotWriter::threadMainFunction()
+{
+	std::unique_lock<std::mutex> lock(pendingMutex);
+
+	while (true)
+	{
+		pendingCondition.wait(lock, [this]() { return hasPendingSnapshot || shouldShutdown; });
+
+		if (!hasPendingSnapshot)
+			break;
+
+		std::swap(pendingData, writeData);
+		const uint32_t generation = pendingGeneration;
+		const uint32_t fitnessCutoff = pendingFitnessCutoff;
+		hasPendingSnapshot = false;
+
+		lock.unlock();
+		const bool written = writeSnapshot(generation, fitnessCutoff);
+		lock.lock();
+
+		// Left for the main thread to report, which can stop the simulation. The other slot still has the last snapshot
+		if (!written && writeError.empty())
+			writeError = "Failed to write population snapshot file: \"" + file + "\"";
+	}
+}
+
+bool EvolutionSnapshotWriter::writeSnapshot(uint32_t generation, uint32_t fitnessCutoff)
+{
+	const uint64_t sequence = lastSequence + 1;
+	const uint32_t slot = uint32_t(sequence & 1);
+	const uint64_t slotOffset = getSlotOffset(slot, slotSize);
+	std::vector<uint8_t> &previousData = slotData[slot];
+
+	// Only the blocks that changed since this slot was last written go to disk
+	for (uint64_t blockBegin = 0; blockBegin < dataSize; blockBegin += blockSize)
+	{
+		const uint64_t size = std::min<uint64_t>(blockSize, dataSize - blockBegin);
+
+		if (previousData.size() == dataSize && memcmp(&previousData[blockBegin], &writeData[blockBegin], size) == 0)
+			continue;
+
+		if (!writeFile(slotOffset + blockSize + blockBegin, &writeData[blockBegin], size))
+		{
+			// What's in the slot isn't known anymore
+			previousData.clear();
+			return false;
+		}
+	}
+
+	// The data has to be on disk before the header that says it's complete
+	if (!syncFile())
+	{
+		previousData.clear();
+		return false;
+	}
+
+	EvolutionSnapshotSlotHeader slotHeader = {};
+	slotHeader.sequence = sequence;
+	slotHeader.generation = generation;
+	slotHeader.fitnessCutoff = fitnessCutoff;
+	slotHeader.dataChecksum = computeChecksum(writeData.data(), dataSize);
+	slotHeader.headerChecksum = computeSlotHeaderChecksum(slotHeader);
+
+	if (!writeFile(slotOffset, &slotHeader, sizeof(slotHeader)) || !syncFile())
+	{
+		previousData.clear();
+		return false;
+	}
+
+	lastSequence = sequence;
+	std::swap(previousData, writeData);
+
+	return true;
+}
+
+void EvolutionSnapshotWriter::exitIfWriteFailed()
+{
+	std::string error;
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		error = writeError;
+	}
+
+	if (!error.empty())
+	{
+		std::cout << error << std::endl;
+		exit(-1);
+	}
+}
+
+void EvolutionSnapshotWriter::readFile(uint64_t offset, void *data, uint64_t size)
+{
+	// A file too short to hold it just reads as zeroes, from memset() by the caller
+#ifdef __linux__
+	if (pread(fileDescriptor, data, size, off_t(offset)) < 0)
+		memset(data, 0, size);
+#else
+	fileStream.seekg(offset);
+	fileStream.read((char*)data, size);
+	fileStream.clear();
+#endif
+}
+
+bool EvolutionSnapshotWriter::writeFile(uint64_t offset, const void *data, uint64_t size)
+{
+#ifdef __linux__
+	const uint8_t *bytes = (const uint8_t*)data;
+
+	while (size > 0)
+	{
+		const ssize_t written = pwrite(fileDescriptor, bytes, size, off_t(offset));
+
+		if (written <= 0)
+			return false;
+
+		bytes += written;
+		offset += uint64_t(written);
+		size -= uint64_t(written);
+	}
+
+	return true;
+#else
+	fileStream.seekp(offset);
+	fileStream.write((const char*)data, size);
+
+	return fileStream.good();
+#endif
+}
+
+bool EvolutionSnapshotWriter::syncFile()
+{
+#ifdef __linux__
+	return fdatasync(fileDescriptor) == 0;
+#else
+	fileStream.flush();
+
+	return fileStream.good();
+#endif
+}
+
+static bool loadEvolutionSnapshotData(const uint8_t *fileData, uint64_t fileSize, const std::string &file, const EvolutionSnapshotLayout &layout, uint32_t &generation, uint32_t &fitnessCutoff, PopulationGenomes &population, FitnessCache &fitnessCache)
+{
+	const EvolutionSnapshotFileHeader fileHeader = createFileHeader(layout);
+
+	if (fileSize < sizeof(fileHeader) || memcmp(fileData, &fileHeader, sizeof(fileHeader)) != 0)
+	{
+		std::cout << "Population snapshot file: \"" << file << "\" isn't a snapshot of this population size, number of angles, fitness cache size and random seed" << std::endl;
+		return false;
+	}
+
+	const uint64_t dataSize = fileHeader.dataSize;
+	const uint64_t slotSize = getSlotSize(dataSize);
+	const uint8_t *snapshotData = nullptr;
+	uint64_t newestSequence = 0;
+
+	for (uint32_t slot = 0; slot < 2; slot++)
+	{
+		const uint64_t slotOffset = getSlotOffset(slot, slotSize);
+
+		if (fileSize < slotOffset + EvolutionSnapshotWriter::blockSize + dataSize)
+			continue;
+
+		EvolutionSnapshotSlotHeader slotHeader;
+		memcpy(&slotHeader, fileData + slotOffset, sizeof(slotHeader));
+
+		const uint8_t *slotData = fileData + slotOffset + EvolutionSnapshotWriter::blockSize;
+
+		if (slotHeader.sequence <= newestSequence || slotHeader.headerChecksum != computeSlotHeaderChecksum(slotHeader) || slotHeader.dataChecksum != computeChecksum(slotData, dataSize))
+			continue;
+
+		newestSequence = slotHeader.sequence;
+		generation = slotHeader.generation;
+		fitnessCutoff = slotHeader.fitnessCutoff;
+		snapshotData = slotData;
+	}
+
+	if (snapshotData == nullptr)
+	{
+		std::cout << "Population snapshot file: \"" << file << "\" has no complete snapshot" << std::endl;
+		return false;
+	}
+
+	const size_t geneCount = size_t(population.memberCount) * population.numAngles;
+
+	fitnessCache.loadEntries((const uint64_t*)snapshotData);
+	snapshotData += fitnessCache.getEntryCount() * sizeof(uint64_t);
+
+	memcpy(population.shellArmAngles.data(), snapshotData, geneCount * sizeof(float));
+	snapshotData += geneCount * sizeof(float);
+	memcpy(population.shellStepperSpeed.data(), snapshotData, geneCount * sizeof(float));
+	snapshotData += geneCount * sizeof(float);
+	memcpy(population.rimRotationsUntilNextAngle.data(), snapshotData, geneCount * sizeof(float));
+	snapshotData += geneCount * sizeof(float);
+	memcpy(population.fitness.data(), snapshotData, population.memberCount * sizeof(uint32_t));
+
+	return true;
+}
+
+bool loadEvolutionSnapshot(const std::string &file, const EvolutionSnapshotLayout &layout, uint32_t &generation, uint32_t &fitnessCutoff, PopulationGenomes &population, FitnessCache &fitnessCache)
+{
+#ifdef __linux__
+	const int fileDescriptor = open(file.c_str(), O_RDONLY);
+	struct stat fileStatus;
+
+	if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+	{
+		if (fileDescriptor >= 0)
+			close(fileDescriptor);
+
+		std::cout << "Failed to open population snapshot file: \"" << file << "\"" << std::endl;
+		return false;
+	}
+
+	const uint64_t fileSize = uint64_t(fileStatus.st_size);
+	void *fileData = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+
+	if (fileData == MAP_FAILED)
+	{
+		std::cout << "Failed to map population snapshot file: \"" << file << "\"" << std::endl;
+		return false;
+	}
+
+	const bool loaded = loadEvolutionSnapshotData((const uint8_t*)fileData, fileSize, file, layout, generation, fitnessCutoff, population, fitnessCache);
+	munmap(fileData, fileSize);
+
+	return loaded;
+#else
+	std::ifstream fileStream(file, std::ios::binary);
+
+	if (!fileStream.is_open())
+	{
+		std::cout << "Failed to open population snapshot file: \"" << file << "\"" << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> fileData((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+
+	return loadEvolutionSnapshotData(fileData.data(), fileData.size(), file, layout, generation, fitnessCutoff, population, fitnessCache);
+#endif
+}
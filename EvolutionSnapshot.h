@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EvolutionSimulation.h>
+#include <FitnessCache.h>
+
+// What a snapshot holds, a snapshot can only be resumed with the same layout
+struct EvolutionSnapshotLayout
+{
+	uint32_t populationSize;
+	uint32_t numAngles;
+	uint64_t fitnessCacheEntryCount;
+	uint64_t randomSeed;
+};
+
+/*
+Periodically saves everything needed to continue an evolution run exactly where it left off: the population about to be
+evaluated, its generation, the fitness cutoff and the fitness cache. Breeding draws from Philox streams keyed by the seed,
+generation and member, so those are the whole RNG state.
+
+The file is a header followed by two slots that snapshots alternate between, each a header block and the data, in native byte
+order. A slot's header is written (and synced) only after its data, with a sequence number and checksums, so a crash mid write
+only ever loses the snapshot being written and the other slot is resumed from instead. Each slot remembers what was last written
+to it and only rewrites the blocks that changed.
+
+Snapshots are taken on the main thread with a single copy, and written on a background thread. If it falls behind, only the
+latest snapshot is kept. If writing or syncing fails, the slot isn't marked complete and the thread calling submit() (or the
+destructor) prints the error and exits, never the writer thread, as the job system is still running.
+*/
+class EvolutionSnapshotWriter
+{
+public:
+
+	static constexpr uint32_t blockSize = 4096;
+
+	/*
+	An existing file with the same layout is written to in place, so the snapshot being resumed from is only replaced once
+	there's a newer one. Anything else is overwritten.
+	*/
+	EvolutionSnapshotWriter(const std::string &file, const EvolutionSnapshotLayout &layout);
+
+	// Writes the pending snapshot, if there is one, before returning, exits if that failed
+	virtual ~EvolutionSnapshotWriter();
+
+	// Copies population (whose fitnesses don't have to be evaluated yet) and the fitness cache and returns. Exits if writing an
+	// earlier snapshot failed
+	void submit(uint32_t generation, uint32_t fitnessCutoff, const PopulationGenomes &population, const FitnessCache &fitnessCache);
+
+private:
+
+	std::string file;
+	EvolutionSnapshotLayout layout;
+	uint64_t dataSize;
+	uint64_t slotSize;
+
+#ifdef __linux__
+	int fileDescriptor;
+#else
+	std::fstream fileStream;
+#endif
+
+	std::thread writerThread;
+	std::mutex pendingMutex;
+	std::condition_variable pendingCondition;
+	bool hasPendingSnapshot;
+	bool shouldShutdown;
+	std::string writeError; // Set by the writer thread the first time writing fails
+
+	// Swapped around rather than copied, so no memory is allocated once each has been filled once
+	std::vector<uint8_t> submitData; // Main thread only
+	std::vector<uint8_t> pendingData;
+	uint32_t pendingGeneration;
+	uint32_t pendingFitnessCutoff;
+
+	// Writer thread only
+	std::vector<uint8_t> writeData;
+	std::vector<uint8_t> slotData[2]; // What's on disk in each slot, empty if unknown
+	uint64_t lastSequence;
+
+	void threadMainFunction();
+	bool writeSnapshot(uint32_t generation, uint32_t fitnessCutoff);
+	void exitIfWriteFailed();
+
+	void readFile(uint64_t offset, void *data, uint64_t size);
+	bool writeFile(uint64_t offset, const void *data, uint64_t size);
+	bool syncFile();
+};
+
+/*
+Memory maps file (on Linux, anywhere else it's read in) and loads its newest complete snapshot into population and
+fitnessCache, which have to be sized for layout already. Prints why and returns false if there's no snapshot to resume with
+that layout.
+
+@param[out] generation The generation population is from, and the first to simulate
+*/
+bool loadEvolutionSnapshot(const std::string &file, const EvolutionSnapshotLayout &layout, uint32_t &generation, uint32_t &fitnessCutoff, PopulationGenomes &population, FitnessCache &fitnessCache);
@@ -0,0 +1,117 @@
+#include "FitnessCache.h"
+
+#include <cmath>
+
+// From splitmix64, mixes all of the input bits into the output
+static inline uint64_t mixHash(uint64_t hash, uint64_t value)
+{
+	uint64_t z = hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t quantize(float value, double quantization)
+{
+	return uint64_t(int64_t(std::llround(double(value) / quantization)));
+}
+
+FitnessCache::FitnessCache(uint32_t entryCount)
+{
+	uint64_t roundedEntryCount = 1;
+
+	while (roundedEntryCount < entryCount)
+		roundedEntryCount <<= 1;
+
+	entries = std::vector<std::atomic<uint64_t>>(roundedEntryCount);
+	entryIndexMask = roundedEntryCount - 1;
+
+	for (std::atomic<uint64_t> &entry : entries)
+		entry = 0;
+
+	hitCount = 0;
+	missCount = 0;
+}
+
+FitnessCache::~FitnessCache()
+{
+
+}
+
+uint64_t FitnessCache::computeKey(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint32_t targetLayers)
+{
+	uint64_t key = 0;
+
+	key = mixHash(key, simConfig.layermapSize);
+	key = mixHash(key, quantize(simConfig.mapFillPrecisionMult, 1e-6));
+	key = mixHash(key, simConfig.errorCalcYAxisSweeps);
+	key = mixHash(key, targetLayers);
+
+	key = mixHash(key, shellConfig.numAngles);
+	key = mixHash(key, quantize(shellConfig.shellDiameter, 1e-6));
+	key = mixHash(key, quantize(shellConfig.tapeWidth, 1e-6));
+	key = mixHash(key, quantize(shellConfig.shellChuckDiameter, 1e-6));
+
+	for (uint32_t a = 0; a < shellConfig.numAngles; a++)
+	{
+		key = mixHash(key, quantize(shellConfig.shellArmAngles[a], armAngleQuantization));
+		key = mixHash(key, quantize(shellConfig.shellStepperSpeed[a], stepperSpeedQuantization));
+		key = mixHash(key, quantize(shellConfig.rimRotationsUntilNextAngle[a], rimRotationsQuantization));
+	}
+
+	return key;
+}
+
+uint32_t FitnessCache::getEntryTag(uint64_t key)
+{
+	// A tag of 0 marks an empty entry
+	const uint32_t tag = uint32_t(key >> 32);
+
+	return tag != 0 ? tag : 1;
+}
+
+bool FitnessCache::find(uint64_t key, uint32_t &fitness)
+{
+	const uint64_t entry = entries[key & entryIndexMask].load(std::memory_order_relaxed);
+
+	if (uint32_t(entry >> 32) != getEntryTag(key))
+	{
+		missCount.fetch_add(1, std::memory_order_relaxed);
+
+		return false;
+	}
+
+	hitCount.fetch_add(1, std::memory_order_relaxed);
+	fitness = uint32_t(entry);
+
+	return true;
+}
+
+void FitnessCache::insert(uint64_t key, uint32_t fitness)
+{
+	entries[key & entryIndexMask].store((uint64_t(getEntryTag(key)) << 32) | fitness, std::memory_order_relaxed);
+}
+
+void FitnessCache::takeStatistics(uint64_t &hits, uint64_t &misses)
+{
+	hits = hitCount.exchange(0);
+	misses = missCount.exchange(0);
+}
+
+uint64_t FitnessCache::getEntryCount() const
+{
+	return entries.size();
+}
+
+void FitnessCache::saveEntries(uint64_t *entryValues) const
+{
+	for (size_t i = 0; i < entries.size(); i++)
+		entryValues[i] = entries[i].load(std::memory_order_relaxed);
+}
+
+void FitnessCache::loadEntries(const uint64_t *entryValues)
+{
+	for (size_t i = 0; i < entries.size(); i++)
+		entries[i].store(entryValues[i], std::memory_order_relaxed);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <ShellSimulation.h>
+
+/*
+A fixed size, lock-free cache of population member fitnesses. Genomes are hashed after quantizing their genes, so that members which
+are (nearly) identical to one simulated before, like the elite carried over each generation, can skip simulation entirely.
+
+Each entry packs the upper 32 bits of the key with the fitness into a single 64 bit atomic, and entries are direct mapped by the lower
+bits of the key, so a collision simply evicts the older entry.
+*/
+class FitnessCache
+{
+public:
+	// The gene quantization, genes closer together than this are treated as the same
+	static constexpr double armAngleQuantization = 1e-3; // In degrees
+	static constexpr double stepperSpeedQuantization = 1e-6;
+	static constexpr double rimRotationsQuantization = 1e-4;
+
+	/*
+	@param[in] entryCount The max number of cached fitnesses, rounded up to a power of 2
+	*/
+	FitnessCache(uint32_t entryCount);
+	virtual ~FitnessCache();
+
+	static uint64_t computeKey(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint32_t targetLayers);
+
+	// Returns true and sets "fitness" if the key is cached, thread safe
+	bool find(uint64_t key, uint32_t &fitness);
+
+	// Thread safe
+	void insert(uint64_t key, uint32_t fitness);
+
+	// Returns the hit & miss counts since the last call
+	void takeStatistics(uint64_t &hits, uint64_t &misses);
+
+	// The number of entries after rounding, how many saveEntries() writes and loadEntries() reads
+	uint64_t getEntryCount() const;
+
+	// Copies every entry out of or into the cache, not safe while other threads are using it
+	void saveEntries(uint64_t *entryValues) const;
+	void loadEntries(const uint64_t *entryValues);
+
+private:
+	std::vector<std::atomic<uint64_t>> entries;
+	uint64_t entryIndexMask;
+
+	std::atomic<uint64_t> hitCount;
+	std::atomic<uint64_t> missCount;
+
+	static uint32_t getEntryTag(uint64_t key);
+};
@@ -2,35 +2,92 @@
 
 #include <algorithm>
 #include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 
 #include <JobSystemWorker.h>
+#include <JobSystemTaskGraph.h>
+#include <JobSystemTopology.h>
+#include <JobSystemTrace.h>
 
 JobSystem *JobSystem::instance = nullptr;
 
-JobSystem::JobSystem(unsigned int maxWorkerCount)
+thread_local JobSystemWorker *JobSystem::currentWorker = nullptr;
+
+JobSystem::JobSystem(unsigned int maxWorkerCount, unsigned int maxExternalThreadCount)
+	: JobSystem(JobSystemConfig{maxWorkerCount, maxExternalThreadCount, false, 0})
+{
+
+}
+
+JobSystem::JobSystem(const JobSystemConfig &config)
 {
 	availableJobs = 0;
 
-	// This workerCount includes the main thread
-	uint32_t workerCount = std::max<uint32_t>(std::min<uint32_t>(std::thread::hardware_concurrency(), maxWorkerCount), 2);
+	// Which CPUs each worker thread may run on, empty means anywhere
+	std::vector<std::vector<uint32_t>> workerThreadCPUs;
+	const std::vector<JobSystemNumaNode> numaNodes = getJobSystemNumaNodes();
 
-	for (uint32_t i = 0; i < workerCount - 1; i++)
+	if (config.workersPerNumaNode > 0)
 	{
-		JobSystemWorker *worker = new JobSystemWorker(this);
-		worker->workerThread = std::thread(std::bind(&JobSystemWorker::threadMainFunction, worker));
-		worker->workerIndex = workers.size();
+		// Each worker is kept on its node, so the memory it touches first stays local to it
+		for (const JobSystemNumaNode &numaNode : numaNodes)
+		{
+			for (uint32_t i = 0; i < std::min<uint32_t>(config.workersPerNumaNode, uint32_t(numaNode.cpus.size())); i++)
+				workerThreadCPUs.push_back(config.pinWorkers ? std::vector<uint32_t>(1, numaNode.cpus[i]) : numaNode.cpus);
+		}
+	}
+	else
+	{
+		// This workerCount includes the main thread
+		uint32_t workerCount = std::max<uint32_t>(std::min<uint32_t>(std::thread::hardware_concurrency(), config.maxWorkerCount), 2);
+		std::vector<uint32_t> cpus;
 
-		workers.push_back(worker);
-		workersThreadIDMap[worker->workerThread.get_id()] = workers.size() - 1;
+		// Going node by node, so that consecutive workers share a node
+		for (const JobSystemNumaNode &numaNode : numaNodes)
+			cpus.insert(cpus.end(), numaNode.cpus.begin(), numaNode.cpus.end());
+
+		for (uint32_t i = 0; i < workerCount - 1; i++)
+			workerThreadCPUs.push_back(config.pinWorkers ? std::vector<uint32_t>(1, cpus[i % cpus.size()]) : std::vector<uint32_t>());
 	}
-	
-	// Note that the main thread "worker" should always be added last
-	workers.push_back(new JobSystemWorker(this));
-	workers.back()->workerIndex = workers.size();
-	workersThreadIDMap[std::this_thread::get_id()] = workers.size() - 1;
-	
-	for (size_t i = 0; i < workers.size(); i++)
+
+	// Always at least one worker thread, as the rest of the job system assumes there's someone else to run jobs
+	if (workerThreadCPUs.empty())
+		workerThreadCPUs.push_back(std::vector<uint32_t>());
+
+	const uint32_t workerThreadCount = uint32_t(workerThreadCPUs.size());
+	const uint32_t externalThreadCount = std::max<uint32_t>(config.maxExternalThreadCount, 1);
+
+	// All the workers are created up front, as other workers index into the list when stealing. The external thread workers
+	// are only active while a thread is registered to them
+	for (uint32_t i = 0; i < workerThreadCount + externalThreadCount; i++)
+	{
+		workers.push_back(new JobSystemWorker(this, workers.size()));
+	}
+
+	// Worker threads move themselves to their CPUs and then allocate their own jobs, so that they're allocated on their node
+	for (uint32_t i = 0; i < workerThreadCount; i++)
+	{
+		workers[i]->affinityCPUs = workerThreadCPUs[i];
+		workers[i]->workerThread = std::thread(std::bind(&JobSystemWorker::threadMainFunction, workers[i]));
+	}
+
+	for (uint32_t i = workerThreadCount; i < workers.size(); i++)
+		workers[i]->allocateJobMemory();
+
+	// Nothing can be stolen until every worker has its deque
+	for (uint32_t i = 0; i < workerThreadCount; i++)
+	{
+		while (!workers[i]->jobMemoryAllocated.load(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+
+	for (uint32_t i = 0; i < workerThreadCount; i++)
 		workers[i]->active = true;
+
+	// The thread creating the job system is always registered, as it's usually the main thread
+	registerThread();
 }
 
 JobSystem::~JobSystem()
@@ -42,59 +99,305 @@ JobSystem::~JobSystem()
 		worker->active = false;
 	}
 
-	availableJobs_cond.notify_all();
+	idleWorkers.notifyAll();
 
 	for (size_t i = 0; i < workers.size(); i++)
 	{
-		JobSystemWorker *worker = workers[i];
+		if (workers[i]->workerThread.joinable())
+			workers[i]->workerThread.join();
+	}
 
-		// In this case it's the main thread
-		if (worker->workerIndex == workers.size() - 1)
-			continue;
+	if (!traceFile.empty())
+	{
+#if JOBSYSTEM_TRACING
+		std::vector<std::vector<JobSystemTraceEvent>> workerEvents;
 
-		if (worker->workerThread.joinable())
-			worker->workerThread.join();
+		for (JobSystemWorker *worker : workers)
+			workerEvents.push_back(worker->traceBuffer.getEvents());
+
+		if (writeJobSystemChromeTrace(traceFile, workerEvents))
+			std::cout << "Wrote job system trace to \"" << traceFile << "\"" << std::endl;
+		else
+			std::cout << "Failed to open file stream for job system trace file: \"" << traceFile << "\"" << std::endl;
+#endif
+	}
+
+	// Only once every worker thread has stopped, as they may still be trying to steal from any of the others
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		if (currentWorker == workers[i])
+			currentWorker = nullptr;
 
 		delete workers[i];
 	}
 }
 
+void JobSystem::registerThread()
+{
+	if (getCurrentWorker() != nullptr)
+		throw std::runtime_error("A thread tried to register with the job system twice");
+
+	for (JobSystemWorker *worker : workers)
+	{
+		bool active = false;
+
+		// Worker threads are always active, so this only ever claims an external thread worker
+		if (!worker->workerThread.joinable() && worker->active.compare_exchange_strong(active, true))
+		{
+			currentWorker = worker;
+			return;
+		}
+	}
+
+	throw std::runtime_error("A thread tried to register with the job system, but all of the external thread slots are taken");
+}
+
+void JobSystem::unregisterThread()
+{
+	JobSystemWorker *worker = getCurrentWorker();
+
+	if (worker == nullptr)
+		throw std::runtime_error("A thread not associated with the job system tried to unregister");
+
+	// Nothing else would run the jobs left in this thread's deque, except by stealing them
+	Job *job = nullptr;
+
+	while ((job = worker->pop()) != nullptr)
+	{
+		availableJobs.fetch_sub(1, std::memory_order_relaxed);
+		worker->executeJob(job);
+	}
+
+	currentWorker = nullptr;
+	worker->active = false;
+}
+
 constexpr uint32_t testDataWorkerSize = 32;
+constexpr uint32_t testRoundCount = 256;
+constexpr uint32_t testJobsPerRound = 4096;
+constexpr uint32_t testParentJobInterval = 64; // Every this many jobs also spawns testDataWorkerSize children
+constexpr uint32_t testTaskGraphTaskCount = 256; // Per graph destroyed without being run, enough of them fill every job pool twice over
+
+struct JobSystemTestData
+{
+	JobSystem *jobSystem;
+	std::atomic<uint32_t> *executions; // Per job, how many times it ran
+	std::atomic<uint64_t> *childExecutions;
+	bool spawnChildren;
+};
 
 void jobSystemTestFunc(Job *job)
 {
+	JobSystemTestData &testData = *reinterpret_cast<JobSystemTestData *>(job->usrData);
+	testData.executions->fetch_add(1, std::memory_order_relaxed);
+
+	if (!testData.spawnChildren)
+		return;
+
+	// Children are pushed from whichever worker ended up with the parent, so every deque gets pushed to and stolen from
+	for (uint32_t c = 0; c < testDataWorkerSize; c++)
+	{
+		Job *child = testData.jobSystem->allocateJobAsChild(job, [](Job *childJob)
+			{
+				reinterpret_cast<std::atomic<uint64_t> *>(childJob->usrData)->fetch_add(1, std::memory_order_relaxed);
+			});
 
+		child->usrData = reinterpret_cast<void *>(testData.childExecutions);
+		testData.jobSystem->runJob(child);
+	}
 }
 
+void jobSystemTestTaskGraphs(JobSystem &jobSystem)
+{
+	// A diamond, the two middle tasks can run at the same time but only after the first, and the last only after both
+	for (uint32_t r = 0; r < testRoundCount; r++)
+	{
+		std::atomic<uint32_t> finishedTasks(0);
+		uint32_t finishOrder[4] = {};
+
+		JobSystemTaskGraph graph(&jobSystem);
+		uint32_t tasks[4];
+
+		for (uint32_t t = 0; t < 4; t++)
+		{
+			uint32_t *order = &finishOrder[t];
+			std::atomic<uint32_t> *finished = &finishedTasks;
+			tasks[t] = graph.addTask([order, finished]() { *order = finished->fetch_add(1) + 1; });
+		}
+
+		graph.addDependency(tasks[0], tasks[1]);
+		graph.addDependency(tasks[0], tasks[2]);
+		graph.addDependency(tasks[1], tasks[3]);
+		graph.addDependency(tasks[2], tasks[3]);
+		graph.run();
+
+		if (finishOrder[0] != 1 || finishOrder[3] != 4 || finishOrder[1] < 2 || finishOrder[2] < 2)
+			throw std::runtime_error("Job system test failed, task graph round " + std::to_string(r) + " finished its diamond out of dependency order");
+	}
+
+	// A rejected dependency isn't added, otherwise the first task would wait on the last forever
+	{
+		std::atomic<uint32_t> finishedTasks(0);
+		uint32_t finishOrder[3] = {};
+		bool rejectedCycle = false;
+
+		JobSystemTaskGraph graph(&jobSystem);
+
+		for (uint32_t t = 0; t < 3; t++)
+		{
+			uint32_t *order = &finishOrder[t];
+			std::atomic<uint32_t> *finished = &finishedTasks;
+			graph.addTask([order, finished]() { *order = finished->fetch_add(1) + 1; });
+		}
+
+		graph.addDependency(0, 1);
+		graph.addDependency(1, 2);
+
+		try
+		{
+			graph.addDependency(2, 0);
+		}
+		catch (const std::runtime_error &)
+		{
+			rejectedCycle = true;
+		}
+
+		if (!rejectedCycle)
+			throw std::runtime_error("Job system test failed, a task graph cycle wasn't rejected");
+
+		graph.run();
+
+		if (finishOrder[0] != 1 || finishOrder[1] != 2 || finishOrder[2] != 3)
+			throw std::runtime_error("Job system test failed, a task graph ran out of order after rejecting a cycle");
+	}
+
+	// Graphs destroyed without being run still run their tasks, or their job slots would never be free again and allocating
+	// would eventually throw
+	std::atomic<uint32_t> executedTasks(0);
+	const uint32_t graphCount = uint32_t(2 * jobSystemMaxJobCount / testTaskGraphTaskCount);
+
+	for (uint32_t g = 0; g < graphCount; g++)
+	{
+		JobSystemTaskGraph graph(&jobSystem);
+		std::atomic<uint32_t> *executed = &executedTasks;
+
+		for (uint32_t t = 0; t < testTaskGraphTaskCount; t++)
+		{
+			const uint32_t task = graph.addTask([executed]() { executed->fetch_add(1, std::memory_order_relaxed); });
+
+			if (t > 0)
+				graph.addDependency(task - 1, task);
+		}
+	}
+
+	if (executedTasks != graphCount * testTaskGraphTaskCount)
+		throw std::runtime_error("Job system test failed, " + std::to_string(executedTasks) + " tasks of graphs that weren't run ran instead of " + std::to_string(graphCount * testTaskGraphTaskCount));
+}
+
+void jobSystemTestParallelFor(JobSystem &jobSystem)
+{
+	std::vector<std::atomic<uint32_t>> executions(testJobsPerRound);
+
+	// 0 is the automatic grain size, 1 splits down to single indices
+	for (uint32_t grainSize : { 0u, 1u })
+	{
+		for (std::atomic<uint32_t> &execution : executions)
+			execution = 0;
+
+		jobSystem.parallelFor(0, testJobsPerRound, grainSize, [&executions](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+					executions[i].fetch_add(1, std::memory_order_relaxed);
+			});
+
+		for (uint32_t i = 0; i < testJobsPerRound; i++)
+		{
+			if (executions[i] != 1)
+				throw std::runtime_error("Job system test failed, parallelFor() with a grain size of " + std::to_string(grainSize) + " ran index " + std::to_string(i) + " " + std::to_string(executions[i]) + " times");
+		}
+	}
+}
+
+/*
+Stress tests the job system, by having all workers run (and steal) many small jobs, some of which spawn children, and checking
+that every job ran exactly once. Then checks that task graphs run in dependency order and that parallelFor() covers its whole
+range. Throws if anything went wrong.
+*/
 void JobSystem::test()
 {
+	std::vector<std::atomic<uint32_t>> executions(testJobsPerRound);
+	std::vector<JobSystemTestData> testData(testJobsPerRound);
+	std::vector<Job*> jobs(testJobsPerRound);
+	std::atomic<uint64_t> childExecutions(0);
+	uint64_t expectedChildExecutions = 0;
+
+	std::cout << "Testing the job system with " << getWorkerCount() << " workers..." << std::endl;
+
+	for (uint32_t r = 0; r < testRoundCount; r++)
+	{
+		// Vary the batch size so the deques are sometimes nearly empty, and the last job is raced for
+		const uint32_t jobCount = 1 + (r * 2654435761u) % testJobsPerRound;
+
+		for (uint32_t j = 0; j < jobCount; j++)
+		{
+			executions[j] = 0;
+
+			testData[j].jobSystem = this;
+			testData[j].executions = &executions[j];
+			testData[j].childExecutions = &childExecutions;
+			testData[j].spawnChildren = (j % testParentJobInterval) == 0;
+
+			jobs[j] = allocateJob(&jobSystemTestFunc);
+			jobs[j]->usrData = reinterpret_cast<void *>(&testData[j]);
+
+			if (testData[j].spawnChildren)
+				expectedChildExecutions += testDataWorkerSize;
+		}
+
+		runJobs(jobs.data(), jobCount);
+		waitForJobs(jobs.data(), jobCount);
+
+		for (uint32_t j = 0; j < jobCount; j++)
+		{
+			if (executions[j] != 1)
+				throw std::runtime_error("Job system test failed, job " + std::to_string(j) + " of round " + std::to_string(r) + " ran " + std::to_string(executions[j]) + " times");
+		}
+
+		if (childExecutions != expectedChildExecutions)
+			throw std::runtime_error("Job system test failed, " + std::to_string(childExecutions) + " child jobs ran instead of " + std::to_string(expectedChildExecutions));
+	}
+
+	jobSystemTestTaskGraphs(*this);
+	jobSystemTestParallelFor(*this);
 
+	std::cout << "Job system test passed, ran " << testRoundCount << " rounds of up to " << testJobsPerRound << " jobs, task graphs and parallelFor()" << std::endl;
 }
 
 Job *JobSystem::allocateJob(void(*jobFunction) (Job*))
 {
-	auto workerIt = workersThreadIDMap.find(std::this_thread::get_id());
+	JobSystemWorker *worker = getCurrentWorker();
 
-	if (workerIt == workersThreadIDMap.end())
+	if (worker == nullptr)
 	{
 		//Log::get()->error("A thread not associated with the job system tried to allocate a job!");
 		throw std::runtime_error("A thread not associated with the job system tried to allocate a job");
 		return nullptr;
 	}
 
-	Job *job = workers[workerIt->second]->allocateJob();
+	Job *job = worker->allocateJob();
 	job->jobFunction = jobFunction;
 	job->parent = nullptr;
 	job->unfinishedJobs = 1;
+	job->waitingThreads = 0;
 
 	return job;
 }
 
 Job *JobSystem::allocateJobAsChild(Job *parent, void(*jobFunction) (Job*))
 {
-	auto workerIt = workersThreadIDMap.find(std::this_thread::get_id());
+	JobSystemWorker *worker = getCurrentWorker();
 
-	if (workerIt == workersThreadIDMap.end())
+	if (worker == nullptr)
 	{
 		//Log::get()->error("A thread not associated with the job system tried to allocate a job!");
 		throw std::runtime_error("A thread not associated with the job system tried to allocate a job");
@@ -103,114 +406,229 @@ Job *JobSystem::allocateJobAsChild(Job *parent, void(*jobFunction) (Job*))
 
 	parent->unfinishedJobs++;
 
-	Job *job = workers[workerIt->second]->allocateJob();
+	Job *job = worker->allocateJob();
 	job->jobFunction = jobFunction;
 	job->parent = parent;
 	job->unfinishedJobs = 1;
+	job->waitingThreads = 0;
 
 	return job;
 }
 
 void JobSystem::runJob(Job *job)
 {
-	auto workerIt = workersThreadIDMap.find(std::this_thread::get_id());
+	JobSystemWorker *worker = getCurrentWorker();
 
-	if (workerIt == workersThreadIDMap.end())
+	if (worker == nullptr)
 	{
 		//Log::get()->error("A thread not associated with the job system tried to run a job!");
 		throw std::runtime_error("A thread not associated with the job system tried to run a job");
 		return;
 	}
 	
-	workers[workerIt->second]->push(job);
-
-	{
-		std::lock_guard<std::mutex> lck(availableJobs_mutex);
-		availableJobs++;
-	}
-	availableJobs_cond.notify_all();
+	pushJobs(worker, &job, 1);
 }
 
 void JobSystem::runJobs(const std::vector<Job*> &jobs)
 {
-	auto workerIt = workersThreadIDMap.find(std::this_thread::get_id());
+	JobSystemWorker *worker = getCurrentWorker();
 
-	if (workerIt == workersThreadIDMap.end())
+	if (worker == nullptr)
 	{
 		//Log::get()->error("A thread not associated with the job system tried to run a job!");
 		throw std::runtime_error("A thread not associated with the job system tried to run a job");
 		return;
 	}
 
-	for (Job *job : jobs)
-		workers[workerIt->second]->push(job);
-
-	{
-		std::lock_guard<std::mutex> lck(availableJobs_mutex);
-		availableJobs += uint64_t(jobs.size());
-	}
-	availableJobs_cond.notify_all();
+	pushJobs(worker, const_cast<Job **>(jobs.data()), jobs.size());
 }
 
 void JobSystem::runJobs(Job **jobs, size_t jobCount)
 {
-	auto workerIt = workersThreadIDMap.find(std::this_thread::get_id());
+	JobSystemWorker *worker = getCurrentWorker();
 
-	if (workerIt == workersThreadIDMap.end())
+	if (worker == nullptr)
 	{
 		//Log::get()->error("A thread not associated with the job system tried to run a job!");
 		throw std::runtime_error("A thread not associated with the job system tried to run a job");
 		return;
 	}
 
-	for (size_t i = 0; i < jobCount; i++)
-		workers[workerIt->second]->push(jobs[i]);
+	pushJobs(worker, jobs, jobCount);
+}
+
+void JobSystem::pushJobs(JobSystemWorker *worker, Job **jobs, size_t jobCount)
+{
+	size_t pushedJobs = 0;
 
+	while (pushedJobs < jobCount && worker->push(jobs[pushedJobs]))
+		pushedJobs++;
+
+	// Only wake as many workers as there are new jobs
+	availableJobs.fetch_add(int64_t(pushedJobs), std::memory_order_seq_cst);
+	idleWorkers.notify(pushedJobs);
+
+	// If the deque filled up, the rest are run right here, which also gives the other workers time to drain it
+	for (size_t i = pushedJobs; i < jobCount; i++)
 	{
-		std::lock_guard<std::mutex> lck(availableJobs_mutex);
-		availableJobs += uint64_t(jobCount);
+		if (worker->push(jobs[i]))
+		{
+			availableJobs.fetch_add(1, std::memory_order_seq_cst);
+			idleWorkers.notify(1);
+		}
+		else
+		{
+			worker->executeJob(jobs[i]);
+		}
 	}
-	availableJobs_cond.notify_all();
 }
 
 void JobSystem::waitForJob(Job *job, bool doWorkWhileWaiting)
 {
-	if (!doWorkWhileWaiting)
+	waitForJobs(&job, 1, doWorkWhileWaiting);
+}
+
+void JobSystem::waitForJobs(const std::vector<Job*> &jobs, bool doWorkWhileWaiting)
+{
+	waitForJobs(const_cast<Job **>(jobs.data()), jobs.size(), doWorkWhileWaiting);
+}
+
+void JobSystem::waitForJobs(Job **jobs, size_t jobCount, bool doWorkWhileWaiting)
+{
+	JobSystemWorker *worker = nullptr;
+
+	// Threads not associated with the job system can still wait, they just can't run jobs while doing so
+	if (doWorkWhileWaiting)
+		worker = getCurrentWorker();
+
+	// The generation of each job's slot, a job is finished once it has no unfinished jobs left or its slot has been reused
+	uint32_t inlineGenerations[jobSystemWaitInlineJobCount];
+	std::vector<uint32_t> allocatedGenerations;
+	uint32_t *generations = inlineGenerations;
+
+	if (jobCount > jobSystemWaitInlineJobCount)
 	{
-		while (job->unfinishedJobs > 0)
-			std::this_thread::yield();
+		allocatedGenerations.resize(jobCount);
+		generations = allocatedGenerations.data();
 	}
-	else
+
+	for (size_t i = 0; i < jobCount; i++)
+		generations[i] = jobs[i]->generation.load(std::memory_order_relaxed);
+
+	size_t firstUnfinishedJob = 0;
+	uint32_t backoff = 1;
+
+	while (true)
 	{
-		auto workerIt = workersThreadIDMap.find(std::this_thread::get_id());
+		// Jobs are checked in order, any already finished never need to be checked again
+		while (firstUnfinishedJob < jobCount && (jobs[firstUnfinishedJob]->unfinishedJobs.load(std::memory_order_acquire) == 0
+			|| jobs[firstUnfinishedJob]->generation.load(std::memory_order_relaxed) != generations[firstUnfinishedJob]))
+		{
+			firstUnfinishedJob++;
+		}
+
+		if (firstUnfinishedJob == jobCount)
+			return;
+
+		Job *jobToDoWhileWaiting = nullptr;
+
+		if (worker != nullptr && (jobToDoWhileWaiting = worker->findJob()) != nullptr)
+		{
+			worker->executeJob(jobToDoWhileWaiting);
+			backoff = 1;
+
+			continue;
+		}
 
-		if (workerIt == workersThreadIDMap.end())
+		if (backoff <= jobSystemWaitMaxBackoff)
 		{
-			//Log::get()->warn("A thread not associated with the job system tried to wait on a job and run jobs while waiting!");
+			for (uint32_t i = 0; i < backoff; i++)
+				jobSystemCpuRelax();
 
-			while (job->unfinishedJobs > 0)
-				std::this_thread::yield();
+			backoff *= 2;
 
-			return;
+			continue;
 		}
 
-		Job *jobToDoWhileWaiting = nullptr;
+		// Nothing to do for a while, so park until the job finishes (finishJob() only notifies if it sees a waiting thread)
+		Job *job = jobs[firstUnfinishedJob];
+		const uint64_t finishedKey = finishedJobs.prepareWait();
 
-		while (job->unfinishedJobs > 0)
+		job->waitingThreads.fetch_add(1, std::memory_order_seq_cst);
+
+		if (job->unfinishedJobs.load(std::memory_order_seq_cst) > 0 && job->generation.load(std::memory_order_relaxed) == generations[firstUnfinishedJob])
 		{
-			if ((jobToDoWhileWaiting = workers[workerIt->second]->findJob()) != nullptr)
-			{
-				workers[workerIt->second]->executeJob(jobToDoWhileWaiting);
-			}
+			if (worker != nullptr)
+				JOBSYSTEM_TRACE(worker, JOB_SYSTEM_TRACE_EVENT_PARK_BEGIN);
+
+			finishedJobs.commitWait(finishedKey);
+
+			if (worker != nullptr)
+				JOBSYSTEM_TRACE(worker, JOB_SYSTEM_TRACE_EVENT_PARK_END);
 		}
+
+		job->waitingThreads.fetch_sub(1, std::memory_order_relaxed);
+		backoff = 1;
 	}
 }
 
+JobSystemWorker *JobSystem::getCurrentWorker()
+{
+	// The thread may be registered with a different job system
+	if (currentWorker != nullptr && currentWorker->jobSystemParent == this)
+		return currentWorker;
+
+	return nullptr;
+}
+
+bool JobSystem::setTraceFile(const std::string &file)
+{
+	traceFile = file;
+
+	return JOBSYSTEM_TRACING != 0;
+}
+
+void JobSystem::takeStealStatistics(uint64_t &stealAttempts, uint64_t &stealSuccesses, uint64_t &stolenJobs)
+{
+	stealAttempts = stealSuccesses = stolenJobs = 0;
+
+	for (JobSystemWorker *worker : workers)
+	{
+		stealAttempts += worker->stealAttempts.exchange(0, std::memory_order_relaxed);
+		stealSuccesses += worker->stealSuccesses.exchange(0, std::memory_order_relaxed);
+		stolenJobs += worker->stolenJobs.exchange(0, std::memory_order_relaxed);
+	}
+}
+
+size_t JobSystem::getCurrentWorkerQueuedJobCount()
+{
+	JobSystemWorker *worker = getCurrentWorker();
+
+	if (worker == nullptr)
+		return 0;
+
+	return size_t(std::max<int64_t>(worker->bottom.load(std::memory_order_relaxed) - worker->top.load(std::memory_order_relaxed), 0));
+}
+
 uint32_t JobSystem::getWorkerCount()
 {
 	return (uint32_t) workers.size();
 }
 
+uint32_t JobSystem::getCurrentWorkerIndex()
+{
+	JobSystemWorker *worker = getCurrentWorker();
+
+	if (worker == nullptr)
+	{
+		//Log::get()->error("A thread not associated with the job system tried to get its worker index!");
+		throw std::runtime_error("A thread not associated with the job system tried to get its worker index");
+		return 0;
+	}
+
+	return (uint32_t) worker->workerIndex;
+}
+
 void JobSystem::setInstance(JobSystem *instancePtr)
 {
 	instance = instancePtr;
@@ -2,21 +2,40 @@
 #define UTIL_JOBSYSTEM_H_
 
 #include <vector>
-#include <map>
+#include <string>
 #include <thread>
+#include <algorithm>
+#include <new>
+#include <type_traits>
 
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
 
+#include <JobSystemEventCount.h>
+
 class JobSystemWorker;
 
+struct JobSystemConfig
+{
+	uint32_t maxWorkerCount; // Includes the thread creating the job system, capped to the number of CPUs
+	uint32_t maxExternalThreadCount; // See registerThread()
+	bool pinWorkers; // Pins each worker thread to its own CPU, rather than letting the OS move it around
+	uint32_t workersPerNumaNode; // If not 0, overrides maxWorkerCount with this many worker threads per NUMA node, each kept on its node
+};
+
+constexpr uint32_t jobSystemWaitMaxBackoff = 1024; // The most pause iterations a waiting thread does between checking for work, before it parks
+constexpr size_t jobSystemJobFunctionDataSize = 80; // Room for a function object stored in a job, fills out the rest of its two cache lines
+constexpr uint32_t jobSystemParallelForChunksPerWorker = 8; // With an automatic grain size, how many chunks parallelFor() aims for per worker
+constexpr size_t jobSystemWaitInlineJobCount = 64; // How many jobs waitForJobs() can remember the generations of without allocating
+
 typedef struct alignas(64) Job
 {
 private:
 	void(*jobFunction) (Job*);
 	Job *parent; // Can be nullptr, meaning this job has no parent
 	std::atomic<uint64_t> unfinishedJobs; // Includes this job and all children jobs
+	std::atomic<uint32_t> waitingThreads; // Threads parked in waitForJob() until this job finishes
+	std::atomic<uint32_t> generation; // Counts up every time the slot is allocated, so a waiter can tell its job's slot was reused
+	alignas(16) unsigned char functionData[jobSystemJobFunctionDataSize]; // Only used by jobs from allocateFunctionJob()
 
 public:
 	void *usrData;
@@ -30,18 +49,71 @@ class JobSystem
 {
 	public:
 
-	JobSystem(unsigned int maxWorkerCount);
+	/*
+	Creates up to maxWorkerCount - 1 worker threads, plus room for maxExternalThreadCount threads that aren't owned by the job
+	system (such as the main thread) to register themselves. The thread calling the constructor is always registered.
+	*/
+	JobSystem(unsigned int maxWorkerCount, unsigned int maxExternalThreadCount = 1);
+	JobSystem(const JobSystemConfig &config);
 	virtual ~JobSystem();
 
 	Job *allocateJob(void(*jobFunction) (Job*));
 	Job *allocateJobAsChild(Job *parent, void(*jobFunction) (Job*));
 
+	/*
+	Allocates a job that calls function(), which is copied into the job itself so nothing is allocated on the heap. The function
+	object has to fit in jobSystemJobFunctionDataSize bytes and be trivially destructible, which a lambda capturing pointers,
+	references and plain values is. If parent isn't nullptr, the job is allocated as its child.
+	*/
+	template<typename Function>
+	Job *allocateFunctionJob(const Function &function, Job *parent = nullptr);
+
+	/*
+	Calls function(rangeBegin, rangeEnd) over [begin, end) in parallel, and waits until it's done. The range is split in half
+	on demand, only while the calling worker has nothing queued for others to steal, so it's only split as finely as there are
+	idle workers. grainSize is the smallest range a call gets (besides the last), 0 picks one based on the worker count.
+	*/
+	template<typename Function>
+	void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const Function &function);
+
 	void runJob(Job *job);
 	void runJobs(const std::vector<Job*> &jobs);
 	void runJobs(Job **jobs, size_t jobCount);
 	void waitForJob(Job *job, bool doWorkWhileWaiting = true);
 
-	uint32_t getWorkerCount();
+	/*
+	Waits until all of the jobs have finished. While waiting, the calling thread runs its own and stolen jobs, backs off
+	when there are none, and eventually parks until one of the jobs it's waiting on finishes.
+
+	A finished job's slot is reused by the next allocations of the thread that allocated it, so each job's generation is
+	remembered when the wait starts, and a job whose slot has been reused since counts as finished. That makes it safe for
+	the jobs run while waiting to allocate, but a job has to still be in its slot when the wait starts: waited on before the
+	thread that allocated it allocates another jobSystemMaxJobCount jobs after it finished.
+	*/
+	void waitForJobs(const std::vector<Job*> &jobs, bool doWorkWhileWaiting = true);
+	void waitForJobs(Job **jobs, size_t jobCount, bool doWorkWhileWaiting = true);
+
+	/*
+	Lets a thread not owned by the job system allocate, run and wait on jobs. A registered thread has to unregister before it
+	exits, or before the job system is destroyed from a different thread. Both throw if the thread is in the wrong state,
+	or there's no room for another thread.
+	*/
+	void registerThread();
+	void unregisterThread();
+
+	/*
+	Writes what every worker did (jobs, steals, idling) as a Chrome trace to the file when the job system is destroyed. Only
+	works when built with JOBSYSTEM_TRACING defined as 1 (see JobSystemTrace.h), returns false otherwise.
+	*/
+	bool setTraceFile(const std::string &file);
+
+	// Returns the steal counts of all workers since the last call, for tuning
+	void takeStealStatistics(uint64_t &stealAttempts, uint64_t &stealSuccesses, uint64_t &stolenJobs);
+
+	uint32_t getWorkerCount(); // Includes the external thread workers, whether or not a thread is registered to them
+
+	// Returns the index of the calling thread's worker, in [0, getWorkerCount())
+	uint32_t getCurrentWorkerIndex();
 
 	static void setInstance(JobSystem *instancePtr);
 	static JobSystem *get();
@@ -52,14 +124,96 @@ class JobSystem
 
 	static JobSystem *instance;
 
-	uint64_t availableJobs;
-	std::mutex availableJobs_mutex;
-	std::condition_variable availableJobs_cond;
+	std::atomic<int64_t> availableJobs; // The number of jobs sitting in worker deques, waiting to be run
+	JobSystemEventCount idleWorkers; // Workers park on this when there are no available jobs
+	JobSystemEventCount finishedJobs; // Notified when a job that a thread is parked on finishes
 
 	std::vector<JobSystemWorker*> workers;
-	std::map<std::thread::id, size_t> workersThreadIDMap;
+	std::string traceFile;
+
+	static thread_local JobSystemWorker *currentWorker; // The worker of the calling thread, if any
+
+	JobSystemWorker *getCurrentWorker();
+
+	void pushJobs(JobSystemWorker *worker, Job **jobs, size_t jobCount);
+
+	size_t getCurrentWorkerQueuedJobCount();
+
+	template<typename Function>
+	static void runFunctionJob(Job *job);
+
+	template<typename Function>
+	void parallelForRange(Job *rootJob, const Function *function, uint32_t begin, uint32_t end, uint32_t grainSize);
 
 	friend class JobSystemWorker;
 };
 
+template<typename Function>
+Job *JobSystem::allocateFunctionJob(const Function &function, Job *parent)
+{
+	static_assert(sizeof(Function) <= jobSystemJobFunctionDataSize, "The function object is too big to be stored in a job, capture less or by reference");
+	static_assert(alignof(Function) <= 16, "The function object is too aligned to be stored in a job");
+	static_assert(std::is_trivially_destructible<Function>::value, "The function object stored in a job is never destroyed, so it has to be trivially destructible");
+
+	Job *job = parent != nullptr ? allocateJobAsChild(parent, &runFunctionJob<Function>) : allocateJob(&runFunctionJob<Function>);
+	new (job->functionData) Function(function);
+
+	return job;
+}
+
+template<typename Function>
+void JobSystem::runFunctionJob(Job *job)
+{
+	(*std::launder(reinterpret_cast<Function *>(job->functionData)))();
+}
+
+template<typename Function>
+void JobSystem::parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const Function &function)
+{
+	if (begin >= end)
+		return;
+
+	if (grainSize == 0)
+		grainSize = std::max<uint32_t>((end - begin) / (getWorkerCount() * jobSystemParallelForChunksPerWorker), 1);
+
+	// All the split off ranges are children of the root, so waiting on it waits on all of them
+	const Function *functionPtr = &function;
+	Job *rootJob = nullptr;
+
+	// The root's range reads rootJob when it runs, which is only after it's been set
+	rootJob = allocateFunctionJob([this, &rootJob, functionPtr, begin, end, grainSize]()
+		{
+			parallelForRange(rootJob, functionPtr, begin, end, grainSize);
+		});
+
+	runJob(rootJob);
+	waitForJob(rootJob);
+}
+
+template<typename Function>
+void JobSystem::parallelForRange(Job *rootJob, const Function *function, uint32_t begin, uint32_t end, uint32_t grainSize)
+{
+	while (begin < end)
+	{
+		// Lazy binary splitting: only split off more work once the last split off half has been stolen (or run)
+		if (end - begin > grainSize && getCurrentWorkerQueuedJobCount() == 0)
+		{
+			const uint32_t middle = begin + (end - begin) / 2;
+
+			runJob(allocateFunctionJob([this, rootJob, function, middle, end, grainSize]()
+				{
+					parallelForRange(rootJob, function, middle, end, grainSize);
+				}, rootJob));
+
+			end = middle;
+			continue;
+		}
+
+		const uint32_t chunkEnd = begin + std::min(grainSize, end - begin);
+		(*function)(begin, chunkEnd);
+
+		begin = chunkEnd;
+	}
+}
+
 #endif /* UTIL_JOBSYSTEM_H_ */
\ No newline at end of file
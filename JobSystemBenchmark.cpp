@@ -0,0 +1,219 @@
+#include "JobSystemBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+constexpr uint32_t benchmarkSpawnWaitCount = 20000;
+constexpr uint32_t benchmarkBatchSize = 4096;
+constexpr uint32_t benchmarkBatchCount = 64;
+constexpr uint32_t benchmarkFanOutChildren = 4096;
+constexpr uint32_t benchmarkFanOutCount = 32;
+constexpr uint32_t benchmarkTinyJobIterations = 256;
+
+void jobSystemBenchmarkEmptyJob(Job*)
+{
+
+}
+
+void jobSystemBenchmarkTinyJob(Job *job)
+{
+	// Some dependent arithmetic the compiler can't throw away, as the result is written to the job
+	uint64_t value = reinterpret_cast<uint64_t>(job);
+
+	for (uint32_t i = 0; i < benchmarkTinyJobIterations; i++)
+		value = value * 6364136223846793005ull + 1442695040888963407ull;
+
+	job->usrData = reinterpret_cast<void *>(value);
+}
+
+struct JobSystemBenchmarkFanOutData
+{
+	JobSystem *jobSystem;
+	uint32_t childCount;
+};
+
+void jobSystemBenchmarkFanOutJob(Job *job)
+{
+	JobSystemBenchmarkFanOutData &fanOutData = *reinterpret_cast<JobSystemBenchmarkFanOutData *>(job->usrData);
+
+	for (uint32_t c = 0; c < fanOutData.childCount; c++)
+		fanOutData.jobSystem->runJob(fanOutData.jobSystem->allocateJobAsChild(job, &jobSystemBenchmarkEmptyJob));
+}
+
+// Times a benchmark, operations is how many operations the function does in total
+template<typename Function>
+JobSystemBenchmarkResult runJobSystemBenchmark(JobSystem &jobSystem, const std::string &name, uint64_t operations, const Function &function)
+{
+	uint64_t stealAttempts, stealSuccesses, stolenJobs;
+	jobSystem.takeStealStatistics(stealAttempts, stealSuccesses, stolenJobs);
+
+	const auto startTime = std::chrono::steady_clock::now();
+	function();
+	const auto endTime = std::chrono::steady_clock::now();
+
+	jobSystem.takeStealStatistics(stealAttempts, stealSuccesses, stolenJobs);
+
+	JobSystemBenchmarkResult result = {};
+	result.name = name;
+	result.workerCount = jobSystem.getWorkerCount();
+	result.operations = operations;
+	result.totalMilliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	result.nanosecondsPerOperation = result.totalMilliseconds * 1000000.0 / double(std::max<uint64_t>(operations, 1));
+	result.operationsPerSecond = result.totalMilliseconds > 0 ? double(operations) * 1000.0 / result.totalMilliseconds : 0;
+	result.stealAttempts = stealAttempts;
+	result.stealSuccesses = stealSuccesses;
+	result.stolenJobs = stolenJobs;
+
+	std::cout << std::left << std::setw(20) << name << " workers: " << std::setw(4) << result.workerCount << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(12) << result.nanosecondsPerOperation << " ns/op" << std::setw(16) << result.operationsPerSecond << " ops/s" << std::endl;
+
+	return result;
+}
+
+void runJobSystemBenchmarks(JobSystem &jobSystem, std::vector<JobSystemBenchmarkResult> &results)
+{
+	std::vector<Job*> jobs(benchmarkBatchSize);
+
+	results.push_back(runJobSystemBenchmark(jobSystem, "spawn-wait-local", benchmarkSpawnWaitCount, [&]()
+		{
+			for (uint32_t i = 0; i < benchmarkSpawnWaitCount; i++)
+			{
+				Job *job = jobSystem.allocateJob(&jobSystemBenchmarkEmptyJob);
+				jobSystem.runJob(job);
+				jobSystem.waitForJob(job);
+			}
+		}));
+
+	results.push_back(runJobSystemBenchmark(jobSystem, "spawn-wait-remote", benchmarkSpawnWaitCount, [&]()
+		{
+			for (uint32_t i = 0; i < benchmarkSpawnWaitCount; i++)
+			{
+				Job *job = jobSystem.allocateJob(&jobSystemBenchmarkEmptyJob);
+				jobSystem.runJob(job);
+				jobSystem.waitForJob(job, false);
+			}
+		}));
+
+	const auto runBatches = [&](void(*jobFunction) (Job*), bool doWorkWhileWaiting)
+	{
+		for (uint32_t b = 0; b < benchmarkBatchCount; b++)
+		{
+			for (uint32_t j = 0; j < benchmarkBatchSize; j++)
+				jobs[j] = jobSystem.allocateJob(jobFunction);
+
+			jobSystem.runJobs(jobs);
+			jobSystem.waitForJobs(jobs, doWorkWhileWaiting);
+		}
+	};
+
+	results.push_back(runJobSystemBenchmark(jobSystem, "empty-jobs", uint64_t(benchmarkBatchCount) * benchmarkBatchSize, [&]()
+		{
+			runBatches(&jobSystemBenchmarkEmptyJob, true);
+		}));
+
+	results.push_back(runJobSystemBenchmark(jobSystem, "tiny-jobs", uint64_t(benchmarkBatchCount) * benchmarkBatchSize, [&]()
+		{
+			runBatches(&jobSystemBenchmarkTinyJob, true);
+		}));
+
+	results.push_back(runJobSystemBenchmark(jobSystem, "fan-out-fan-in", uint64_t(benchmarkFanOutCount) * (benchmarkFanOutChildren + 1), [&]()
+		{
+			JobSystemBenchmarkFanOutData fanOutData = {};
+			fanOutData.jobSystem = &jobSystem;
+			fanOutData.childCount = benchmarkFanOutChildren;
+
+			for (uint32_t i = 0; i < benchmarkFanOutCount; i++)
+			{
+				Job *parentJob = jobSystem.allocateJob(&jobSystemBenchmarkFanOutJob);
+				parentJob->usrData = reinterpret_cast<void *>(&fanOutData);
+
+				jobSystem.runJob(parentJob);
+				jobSystem.waitForJob(parentJob);
+			}
+		}));
+
+	results.push_back(runJobSystemBenchmark(jobSystem, "steal-contention", uint64_t(benchmarkBatchCount) * benchmarkBatchSize, [&]()
+		{
+			runBatches(&jobSystemBenchmarkTinyJob, false);
+		}));
+}
+
+std::vector<JobSystemBenchmarkResult> runJobSystemBenchmarks(const JobSystemConfig &config, const std::string &resultsFile)
+{
+	std::vector<JobSystemBenchmarkResult> results;
+	uint32_t lastWorkerCount = 0;
+
+	// A job system always has at least one worker thread besides the one creating it, so 2 is the fewest workers there can be
+	for (uint32_t maxWorkerCount = 2; maxWorkerCount <= std::max<uint32_t>(config.maxWorkerCount, 2); maxWorkerCount++)
+	{
+		JobSystemConfig benchmarkConfig = config;
+		benchmarkConfig.maxWorkerCount = maxWorkerCount;
+
+		std::unique_ptr<JobSystem> jobSystem(new JobSystem(benchmarkConfig));
+
+		// The worker count is capped to the number of CPUs, (or fixed per NUMA node), so past that there's nothing new to measure
+		if (jobSystem->getWorkerCount() == lastWorkerCount)
+			break;
+
+		lastWorkerCount = jobSystem->getWorkerCount();
+		runJobSystemBenchmarks(*jobSystem, results);
+	}
+
+	if (!resultsFile.empty())
+	{
+		if (writeJobSystemBenchmarkResults(resultsFile, results))
+			std::cout << "Wrote job system benchmark results to \"" << resultsFile << "\"" << std::endl;
+		else
+			std::cout << "Failed to open file stream for job system benchmark results file: \"" << resultsFile << "\"" << std::endl;
+	}
+
+	return results;
+}
+
+bool writeJobSystemBenchmarkResults(const std::string &file, const std::vector<JobSystemBenchmarkResult> &results)
+{
+	std::ofstream resultsFile(file);
+
+	if (!resultsFile.is_open())
+		return false;
+
+	const bool writeJSON = file.size() >= 5 && file.compare(file.size() - 5, 5, ".json") == 0;
+
+	resultsFile << std::setprecision(6) << std::fixed;
+
+	if (writeJSON)
+	{
+		resultsFile << "[" << std::endl;
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const JobSystemBenchmarkResult &result = results[i];
+
+			resultsFile << "\t{\"name\": \"" << result.name << "\", \"workerCount\": " << result.workerCount << ", \"operations\": " << result.operations
+				<< ", \"totalMilliseconds\": " << result.totalMilliseconds << ", \"nanosecondsPerOperation\": " << result.nanosecondsPerOperation
+				<< ", \"operationsPerSecond\": " << result.operationsPerSecond << ", \"stealAttempts\": " << result.stealAttempts
+				<< ", \"stealSuccesses\": " << result.stealSuccesses << ", \"stolenJobs\": " << result.stolenJobs << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+		}
+
+		resultsFile << "]" << std::endl;
+	}
+	else
+	{
+		resultsFile << "name,workerCount,operations,totalMilliseconds,nanosecondsPerOperation,operationsPerSecond,stealAttempts,stealSuccesses,stolenJobs" << std::endl;
+
+		for (const JobSystemBenchmarkResult &result : results)
+		{
+			resultsFile << result.name << "," << result.workerCount << "," << result.operations << "," << result.totalMilliseconds << "," << result.nanosecondsPerOperation
+				<< "," << result.operationsPerSecond << "," << result.stealAttempts << "," << result.stealSuccesses << "," << result.stolenJobs << std::endl;
+		}
+	}
+
+	resultsFile.close();
+
+	return true;
+}
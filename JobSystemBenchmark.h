@@ -0,0 +1,42 @@
+#ifndef UTIL_JOBSYSTEMBENCHMARK_H_
+#define UTIL_JOBSYSTEMBENCHMARK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <JobSystem.h>
+
+struct JobSystemBenchmarkResult
+{
+	std::string name;
+	uint32_t workerCount; // JobSystem::getWorkerCount() of the job system it ran on
+	uint64_t operations; // What an operation is depends on the benchmark, usually a job
+	double totalMilliseconds;
+	double nanosecondsPerOperation;
+	double operationsPerSecond;
+	uint64_t stealAttempts;
+	uint64_t stealSuccesses;
+	uint64_t stolenJobs; // Steals take up to half of a victim's jobs at once, so this can be more than stealSuccesses
+};
+
+/*
+Benchmarks the job system's scheduling overhead, on a new job system for every worker count from 2 up to config.maxWorkerCount
+(or just the one config when workersPerNumaNode is set). There's no run with 1 worker, as a job system always creates at
+least one worker thread besides the calling thread:
+
+	spawn-wait-local: allocate, run and wait on a single empty job, which the waiting thread ends up running itself
+	spawn-wait-remote: the same, but without working while waiting, so another worker has to wake up and steal it
+	empty-jobs: throughput of batches of empty jobs
+	tiny-jobs: throughput of batches of jobs doing a few hundred nanoseconds of arithmetic
+	fan-out-fan-in: a job spawning many children with allocateJobAsChild, waited on through the parent
+	steal-contention: a batch of tiny jobs all queued on one worker that doesn't run any, so every one has to be stolen
+
+The calling thread must not be registered with any other job system while this runs. Returns the results, and writes them
+to resultsFile as JSON if it ends in ".json" or CSV otherwise (if it isn't empty).
+*/
+std::vector<JobSystemBenchmarkResult> runJobSystemBenchmarks(const JobSystemConfig &config, const std::string &resultsFile);
+
+bool writeJobSystemBenchmarkResults(const std::string &file, const std::vector<JobSystemBenchmarkResult> &results);
+
+#endif /* UTIL_JOBSYSTEMBENCHMARK_H_ */
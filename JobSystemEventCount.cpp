@@ -0,0 +1,55 @@
+#include "JobSystemEventCount.h"
+
+JobSystemEventCount::JobSystemEventCount()
+{
+	epoch = 0;
+	waiters = 0;
+}
+
+JobSystemEventCount::~JobSystemEventCount()
+{
+
+}
+
+uint64_t JobSystemEventCount::prepareWait()
+{
+	return epoch.load(std::memory_order_seq_cst);
+}
+
+void JobSystemEventCount::commitWait(uint64_t key)
+{
+	std::unique_lock<std::mutex> lck(waiters_mutex);
+
+	// Registering as a waiter before re-checking the epoch pairs with notify() bumping the epoch before checking for waiters, so at least one of them sees the other
+	waiters.fetch_add(1, std::memory_order_seq_cst);
+	waiters_cond.wait(lck, [this, key] { return epoch.load(std::memory_order_seq_cst) != key; });
+	waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void JobSystemEventCount::notify(uint64_t count)
+{
+	epoch.fetch_add(1, std::memory_order_seq_cst);
+
+	const uint64_t currentWaiters = waiters.load(std::memory_order_seq_cst);
+
+	if (currentWaiters == 0 || count == 0)
+		return;
+
+	// Taking the lock makes sure any thread past its epoch check is actually waiting on the condition variable before notifying it
+	std::lock_guard<std::mutex> lck(waiters_mutex);
+
+	if (count >= currentWaiters)
+	{
+		waiters_cond.notify_all();
+	}
+	else
+	{
+		for (uint64_t i = 0; i < count; i++)
+			waiters_cond.notify_one();
+	}
+}
+
+void JobSystemEventCount::notifyAll()
+{
+	notify(UINT64_MAX);
+}
@@ -0,0 +1,43 @@
+#ifndef UTIL_JOBSYSTEMEVENTCOUNT_H_
+#define UTIL_JOBSYSTEMEVENTCOUNT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+/*
+An event count, used to park threads until some condition they're polling might have changed, without any locking on the notify
+side unless a thread is actually parked. Waiting goes:
+
+	uint64_t key = eventCount.prepareWait();
+	if (!condition)
+		eventCount.commitWait(key);
+
+and anything making the condition true calls notify() afterwards. A notify between prepareWait() and commitWait() makes the
+commitWait() return immediately, so no wakeups are missed.
+*/
+class JobSystemEventCount
+{
+	public:
+
+	JobSystemEventCount();
+	virtual ~JobSystemEventCount();
+
+	uint64_t prepareWait();
+	void commitWait(uint64_t key);
+
+	// Wakes up to "count" parked threads
+	void notify(uint64_t count);
+	void notifyAll();
+
+	private:
+
+	std::atomic<uint64_t> epoch;
+	std::atomic<uint64_t> waiters;
+
+	std::mutex waiters_mutex;
+	std::condition_variable waiters_cond;
+};
+
+#endif /* UTIL_JOBSYSTEMEVENTCOUNT_H_ */
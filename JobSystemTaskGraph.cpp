@@ -0,0 +1,100 @@
+#include "JobSystemTaskGraph.h"
+
+#include <stdexcept>
+
+JobSystemTaskGraph::JobSystemTaskGraph(JobSystem *jobSystemPtr)
+{
+	jobSystem = jobSystemPtr;
+	hasRun = false;
+
+	// The root does nothing itself, it's only there to be waited on
+	rootJob = jobSystem->allocateJob(nullptr);
+}
+
+JobSystemTaskGraph::~JobSystemTaskGraph()
+{
+	// The tasks' jobs are already allocated, so they have to be run for their slots to ever be reused. Nothing can be thrown
+	// from here, and the graph can't have a cycle, so the only thing that could go wrong is a task throwing
+	if (!hasRun)
+	{
+		try
+		{
+			run();
+		}
+		catch (...)
+		{
+		}
+	}
+}
+
+void JobSystemTaskGraph::addDependency(uint32_t before, uint32_t after)
+{
+	if (before >= taskJobs.size() || after >= taskJobs.size() || before == after)
+		throw std::runtime_error("Invalid task graph dependency");
+
+	if (hasRun)
+		throw std::runtime_error("Tried to add a dependency to a task graph that already ran");
+
+	// A cycle would never finish, so it's rejected before it's added. It would be one if "before" already depends on "after"
+	std::vector<uint8_t> visitedTasks(taskJobs.size(), 0);
+	std::vector<uint32_t> tasksToVisit(1, after);
+	visitedTasks[after] = 1;
+
+	while (!tasksToVisit.empty())
+	{
+		const uint32_t task = tasksToVisit.back();
+		tasksToVisit.pop_back();
+
+		if (task == before)
+			throw std::runtime_error("Task graph dependency would create a cycle");
+
+		for (uint32_t successor : taskSuccessors[task])
+		{
+			if (!visitedTasks[successor])
+			{
+				visitedTasks[successor] = 1;
+				tasksToVisit.push_back(successor);
+			}
+		}
+	}
+
+	taskSuccessors[before].push_back(after);
+	taskDependencyCounts[after]++;
+}
+
+void JobSystemTaskGraph::run()
+{
+	if (hasRun)
+		throw std::runtime_error("A task graph can only be run once");
+
+	hasRun = true;
+
+	// addDependency() never lets in a cycle, so every task is reachable from one without dependencies
+	unfinishedTaskDependencies.reset(new std::atomic<uint32_t>[taskJobs.size()]);
+
+	for (size_t t = 0; t < taskJobs.size(); t++)
+		unfinishedTaskDependencies[t] = taskDependencyCounts[t];
+
+	// Everything else gets run by finishTask() once its dependencies are done
+	std::vector<Job*> readyJobs;
+
+	for (size_t t = 0; t < taskJobs.size(); t++)
+	{
+		if (taskDependencyCounts[t] == 0)
+			readyJobs.push_back(taskJobs[t]);
+	}
+
+	readyJobs.push_back(rootJob);
+
+	jobSystem->runJobs(readyJobs);
+	jobSystem->waitForJob(rootJob);
+}
+
+void JobSystemTaskGraph::finishTask(uint32_t task)
+{
+	for (uint32_t successor : taskSuccessors[task])
+	{
+		if (unfinishedTaskDependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			jobSystem->runJob(taskJobs[successor]);
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef UTIL_JOBSYSTEMTASKGRAPH_H_
+#define UTIL_JOBSYSTEMTASKGRAPH_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <JobSystem.h>
+
+/*
+A set of tasks with dependencies between them, run on a JobSystem. Every task is a job allocated as a child of the graph's
+root job, and a task is only run once all of the tasks it depends on have finished. A graph is built and run once by a
+single (registered) thread, e.g.:
+
+	JobSystemTaskGraph graph(JobSystem::get());
+	uint32_t load = graph.addTask([&]() { ... });
+	uint32_t process = graph.addTask([&]() { ... });
+	graph.addDependency(load, process);
+	graph.run();
+*/
+class JobSystemTaskGraph
+{
+	public:
+
+	JobSystemTaskGraph(JobSystem *jobSystemPtr);
+	virtual ~JobSystemTaskGraph();
+
+	// Returns the task's index, for addDependency(). The function has the same requirements as for JobSystem::allocateFunctionJob()
+	template<typename Function>
+	uint32_t addTask(const Function &function);
+
+	// Makes the task "after" wait until the task "before" has finished. Throws, without adding it, if it would create a cycle
+	void addDependency(uint32_t before, uint32_t after);
+
+	// Runs every task and waits until they've all finished
+	void run();
+
+	private:
+
+	JobSystem *jobSystem;
+	Job *rootJob;
+	bool hasRun;
+
+	std::vector<Job*> taskJobs;
+	std::vector<std::vector<uint32_t>> taskSuccessors;
+	std::vector<uint32_t> taskDependencyCounts;
+	std::unique_ptr<std::atomic<uint32_t>[]> unfinishedTaskDependencies;
+
+	void finishTask(uint32_t task);
+};
+
+template<typename Function>
+uint32_t JobSystemTaskGraph::addTask(const Function &function)
+{
+	const uint32_t task = uint32_t(taskJobs.size());
+
+	taskJobs.push_back(jobSystem->allocateFunctionJob([this, task, function]()
+		{
+			function();
+			finishTask(task);
+		}, rootJob));
+
+	taskSuccessors.emplace_back();
+	taskDependencyCounts.push_back(0);
+
+	return task;
+}
+
+#endif /* UTIL_JOBSYSTEMTASKGRAPH_H_ */
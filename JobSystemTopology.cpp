@@ -0,0 +1,104 @@
+#include "JobSystemTopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+std::vector<JobSystemNumaNode> getJobSystemNumaNodes()
+{
+	std::vector<JobSystemNumaNode> numaNodes;
+
+#ifdef __linux__
+	std::ifstream onlineNodesFile("/sys/devices/system/node/online");
+	std::string onlineNodes;
+
+	if (onlineNodesFile.is_open() && std::getline(onlineNodesFile, onlineNodes))
+	{
+		for (uint32_t nodeIndex : parseCPUList(onlineNodes))
+		{
+			std::ifstream nodeCPUsFile("/sys/devices/system/node/node" + std::to_string(nodeIndex) + "/cpulist");
+			std::string nodeCPUs;
+
+			if (!nodeCPUsFile.is_open() || !std::getline(nodeCPUsFile, nodeCPUs))
+				continue;
+
+			JobSystemNumaNode numaNode = {};
+			numaNode.nodeIndex = nodeIndex;
+			numaNode.cpus = parseCPUList(nodeCPUs);
+
+			// Memory only nodes have no CPUs to put workers on
+			if (!numaNode.cpus.empty())
+				numaNodes.push_back(numaNode);
+		}
+	}
+#endif
+
+	if (numaNodes.empty())
+	{
+		JobSystemNumaNode numaNode = {};
+		numaNode.nodeIndex = 0;
+
+		for (uint32_t cpu = 0; cpu < std::max<uint32_t>(std::thread::hardware_concurrency(), 1); cpu++)
+			numaNode.cpus.push_back(cpu);
+
+		numaNodes.push_back(numaNode);
+	}
+
+	return numaNodes;
+}
+
+bool setCurrentThreadAffinity(const std::vector<uint32_t> &cpus)
+{
+#ifdef __linux__
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+
+	for (uint32_t cpu : cpus)
+	{
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &cpuSet);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+	(void) cpus;
+	return false;
+#endif
+}
+
+std::vector<uint32_t> parseCPUList(const std::string &cpuList)
+{
+	std::vector<uint32_t> cpus;
+	std::stringstream cpuListStream(cpuList);
+	std::string range;
+
+	while (std::getline(cpuListStream, range, ','))
+	{
+		if (range.empty() || range.find_first_of("0123456789") == std::string::npos)
+			continue;
+
+		const size_t dash = range.find('-');
+
+		try
+		{
+			const uint32_t first = uint32_t(std::stoul(range.substr(0, dash)));
+			const uint32_t last = dash == std::string::npos ? first : uint32_t(std::stoul(range.substr(dash + 1)));
+
+			for (uint32_t cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		}
+		catch (std::exception &)
+		{
+			continue;
+		}
+	}
+
+	return cpus;
+}
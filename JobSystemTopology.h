@@ -0,0 +1,29 @@
+#ifndef UTIL_JOBSYSTEMTOPOLOGY_H_
+#define UTIL_JOBSYSTEMTOPOLOGY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct JobSystemNumaNode
+{
+	uint32_t nodeIndex;
+	std::vector<uint32_t> cpus; // The logical CPUs on this node
+};
+
+/*
+Returns the NUMA nodes of the machine and the CPUs on each. Only Linux is actually queried (through sysfs), anywhere else, or
+if it can't be read, everything is reported as a single node with std::thread::hardware_concurrency() CPUs.
+*/
+std::vector<JobSystemNumaNode> getJobSystemNumaNodes();
+
+/*
+Restricts the calling thread to the given CPUs. Memory is placed on the node of the thread that first touches it, so a thread
+should be moved before it allocates its own buffers. Returns false if it failed or isn't supported on this platform.
+*/
+bool setCurrentThreadAffinity(const std::vector<uint32_t> &cpus);
+
+// Parses a Linux CPU list, such as "0-3,8,10-11"
+std::vector<uint32_t> parseCPUList(const std::string &cpuList);
+
+#endif /* UTIL_JOBSYSTEMTOPOLOGY_H_ */
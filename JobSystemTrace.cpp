@@ -0,0 +1,107 @@
+#include "JobSystemTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+JobSystemTraceBuffer::JobSystemTraceBuffer()
+{
+	eventCount = 0;
+}
+
+JobSystemTraceBuffer::~JobSystemTraceBuffer()
+{
+
+}
+
+void JobSystemTraceBuffer::allocate()
+{
+	events.assign(jobSystemTraceBufferSize, JobSystemTraceEvent());
+	eventCount = 0;
+}
+
+std::vector<JobSystemTraceEvent> JobSystemTraceBuffer::getEvents() const
+{
+	std::vector<JobSystemTraceEvent> orderedEvents;
+
+	if (events.empty())
+		return orderedEvents;
+
+	const uint64_t firstEvent = eventCount > jobSystemTraceBufferSize ? eventCount - jobSystemTraceBufferSize : 0;
+
+	for (uint64_t i = firstEvent; i < eventCount; i++)
+		orderedEvents.push_back(events[i & (jobSystemTraceBufferSize - 1u)]);
+
+	return orderedEvents;
+}
+
+uint64_t JobSystemTraceBuffer::getJobSystemTraceTimestamp()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool writeJobSystemChromeTrace(const std::string &file, const std::vector<std::vector<JobSystemTraceEvent>> &workerEvents)
+{
+	std::ofstream traceFile(file);
+
+	if (!traceFile.is_open())
+		return false;
+
+	// Timestamps are written in microseconds from the first event
+	uint64_t firstTimestamp = UINT64_MAX;
+
+	for (const std::vector<JobSystemTraceEvent> &events : workerEvents)
+	{
+		if (!events.empty())
+			firstTimestamp = std::min(firstTimestamp, events.front().timestamp);
+	}
+
+	traceFile << "{\"traceEvents\":[" << std::endl;
+	bool firstEvent = true;
+
+	for (size_t w = 0; w < workerEvents.size(); w++)
+	{
+		traceFile << (firstEvent ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << w << ",\"args\":{\"name\":\"Worker " << w << "\"}}";
+		firstEvent = false;
+
+		for (const JobSystemTraceEvent &event : workerEvents[w])
+		{
+			const double timestamp = double(event.timestamp - firstTimestamp) / 1000.0;
+			traceFile << ",\n{\"pid\":0,\"tid\":" << w << ",\"ts\":" << std::fixed << timestamp << ",";
+
+			switch (event.type)
+			{
+				case JOB_SYSTEM_TRACE_EVENT_JOB_BEGIN:
+					traceFile << "\"name\":\"job\",\"ph\":\"B\"},\n";
+					traceFile << "{\"pid\":0,\"tid\":" << w << ",\"ts\":" << timestamp << ",\"name\":\"queue depth " << w << "\",\"ph\":\"C\",\"args\":{\"jobs\":" << event.value << "}}";
+					break;
+				case JOB_SYSTEM_TRACE_EVENT_JOB_END:
+					traceFile << "\"name\":\"job\",\"ph\":\"E\"}";
+					break;
+				case JOB_SYSTEM_TRACE_EVENT_STEAL:
+					traceFile << "\"name\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"jobs\":" << event.value << "}}";
+					break;
+				case JOB_SYSTEM_TRACE_EVENT_IDLE_BEGIN:
+					traceFile << "\"name\":\"idle\",\"ph\":\"B\"}";
+					break;
+				case JOB_SYSTEM_TRACE_EVENT_IDLE_END:
+					traceFile << "\"name\":\"idle\",\"ph\":\"E\"}";
+					break;
+				case JOB_SYSTEM_TRACE_EVENT_PARK_BEGIN:
+					traceFile << "\"name\":\"parked\",\"ph\":\"B\"}";
+					break;
+				case JOB_SYSTEM_TRACE_EVENT_PARK_END:
+					traceFile << "\"name\":\"parked\",\"ph\":\"E\"}";
+					break;
+				default:
+					traceFile << "\"name\":\"unknown\",\"ph\":\"i\",\"s\":\"t\"}";
+					break;
+			}
+		}
+	}
+
+	traceFile << std::endl << "]}" << std::endl;
+	traceFile.close();
+
+	return true;
+}
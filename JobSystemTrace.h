@@ -0,0 +1,75 @@
+#ifndef UTIL_JOBSYSTEMTRACE_H_
+#define UTIL_JOBSYSTEMTRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Define as 1 to record what every worker is doing, see JobSystem::setTraceFile(). When 0 none of it is compiled in
+#ifndef JOBSYSTEM_TRACING
+#define JOBSYSTEM_TRACING 0
+#endif
+
+constexpr uint32_t jobSystemTraceBufferSize = 1u << 18; // Events kept per worker, older ones are overwritten. ALWAYS keep as a power of 2
+
+enum JobSystemTraceEventType
+{
+	JOB_SYSTEM_TRACE_EVENT_JOB_BEGIN, // value is the number of jobs left in the worker's deque
+	JOB_SYSTEM_TRACE_EVENT_JOB_END,
+	JOB_SYSTEM_TRACE_EVENT_STEAL, // value is the number of jobs stolen
+	JOB_SYSTEM_TRACE_EVENT_IDLE_BEGIN,
+	JOB_SYSTEM_TRACE_EVENT_IDLE_END,
+	JOB_SYSTEM_TRACE_EVENT_PARK_BEGIN,
+	JOB_SYSTEM_TRACE_EVENT_PARK_END
+};
+
+struct JobSystemTraceEvent
+{
+	uint64_t timestamp; // In nanoseconds, from an arbitrary point
+	uint32_t type;
+	uint32_t value;
+};
+
+/*
+A ring buffer of a worker's events, only ever recorded to by the thread that owns the worker.
+*/
+class JobSystemTraceBuffer
+{
+	public:
+
+	JobSystemTraceBuffer();
+	virtual ~JobSystemTraceBuffer();
+
+	void allocate();
+
+	inline void record(JobSystemTraceEventType type, uint32_t value = 0)
+	{
+		JobSystemTraceEvent &event = events[eventCount++ & (jobSystemTraceBufferSize - 1u)];
+		event.timestamp = getJobSystemTraceTimestamp();
+		event.type = uint32_t(type);
+		event.value = value;
+	}
+
+	// Returns the events still in the buffer, oldest first
+	std::vector<JobSystemTraceEvent> getEvents() const;
+
+	static uint64_t getJobSystemTraceTimestamp();
+
+	private:
+
+	std::vector<JobSystemTraceEvent> events;
+	uint64_t eventCount;
+};
+
+/*
+Writes each worker's events as a Chrome trace (chrome://tracing or ui.perfetto.dev), with a thread per worker.
+*/
+bool writeJobSystemChromeTrace(const std::string &file, const std::vector<std::vector<JobSystemTraceEvent>> &workerEvents);
+
+#if JOBSYSTEM_TRACING
+#define JOBSYSTEM_TRACE(worker, ...) (worker)->traceBuffer.record(__VA_ARGS__)
+#else
+#define JOBSYSTEM_TRACE(worker, ...) ((void) 0)
+#endif
+
+#endif /* UTIL_JOBSYSTEMTRACE_H_ */
@@ -1,10 +1,17 @@
 #include "JobSystemWorker.h"
 
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
 #include <JobSystem.h>
+#include <JobSystemTopology.h>
 
-JobSystemWorker::JobSystemWorker(JobSystem *jobSystemParentPtr)
+JobSystemWorker::JobSystemWorker(JobSystem *jobSystemParentPtr, size_t workerIndexValue)
 {
 	jobSystemParent = jobSystemParentPtr;
+	workerIndex = workerIndexValue;
 	active = false;
 	shouldShutdown = false;
 
@@ -12,8 +19,16 @@ JobSystemWorker::JobSystemWorker(JobSystem *jobSystemParentPtr)
 	top = 0;
 	allocatedJobs = 0;
 
-	jobPool = new Job[jobSystemMaxJobCount];
-	jobDeque = new Job*[jobSystemMaxJobCount];
+	stealAttempts = 0;
+	stealSuccesses = 0;
+	stolenJobs = 0;
+
+	// Any non-zero seed works for xorshift, this just keeps each worker's sequence different
+	randomState = (uint64_t(workerIndex) + 1) * 0x9E3779B97F4A7C15ull;
+
+	jobPool = nullptr;
+	jobDeque = nullptr;
+	jobMemoryAllocated = false;
 }
 
 JobSystemWorker::~JobSystemWorker()
@@ -22,51 +37,93 @@ JobSystemWorker::~JobSystemWorker()
 	delete[] jobDeque;
 }
 
-void JobSystemWorker::push(Job *job)
+void JobSystemWorker::allocateJobMemory()
 {
-	int64_t b = bottom;
-	jobDeque[b & jobSystemJobCountMask] = job;
-	
-	bottom = b + 1;
+	jobPool = new Job[jobSystemMaxJobCount];
+	jobDeque = new std::atomic<Job*>[jobSystemMaxJobCount];
+
+	// Every slot starts out finished, so it can be allocated. This is also what first touches the memory, placing it on the
+	// calling thread's NUMA node
+	for (uint64_t i = 0; i < jobSystemMaxJobCount; i++)
+	{
+		jobPool[i].unfinishedJobs = 0;
+		jobPool[i].waitingThreads = 0;
+		jobPool[i].generation = 0;
+		jobDeque[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+#if JOBSYSTEM_TRACING
+	traceBuffer.allocate();
+#endif
+
+	jobMemoryAllocated.store(true, std::memory_order_release);
+}
+
+/*
+The deque is the Chase-Lev work stealing deque, with the memory ordering from "Correct and Efficient Work-Stealing for Weak
+Memory Models" (Le et al. 2013). Only the owning worker pushes and pops at the bottom, any other worker steals from the top.
+*/
+bool JobSystemWorker::push(Job *job)
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+
+	// Full, it's up to the caller to deal with the job some other way
+	if (b - t >= int64_t(jobSystemMaxJobCount))
+		return false;
+
+	jobDeque[b & jobSystemJobCountMask].store(job, std::memory_order_relaxed);
+
+	// Makes sure the job is visible to stealers before the new bottom is
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+
+	return true;
 }
 
 Job *JobSystemWorker::pop()
 {
-	int64_t b = bottom - 1;
-	bottom = b;
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
 
-	int64_t t = top;
+	// The new bottom has to be visible before top is read, otherwise a stealer and this could both take the last job
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
 
 	if (t <= b)
 	{
-		Job *job = jobDeque[b & jobSystemJobCountMask];
+		Job *job = jobDeque[b & jobSystemJobCountMask].load(std::memory_order_relaxed);
 
 		if (t != b)
 			return job;
-		
-		if (!std::atomic_compare_exchange_weak(&top, &t, t + 1))
-			job =  nullptr;
 
-		bottom = t + 1;
+		// The last job, race any stealers for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+
+		bottom.store(b + 1, std::memory_order_relaxed);
 		return job;
 	}
-	else	
+	else
 	{
-		bottom = t;
+		bottom.store(b + 1, std::memory_order_relaxed);
 		return nullptr;
 	}
 }
 
 Job *JobSystemWorker::steal()
 {
-	int64_t t = top;
-	int64_t b = bottom;
+	int64_t t = top.load(std::memory_order_acquire);
+
+	// Pairs with the fence in pop(), so top is read before bottom
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t b = bottom.load(std::memory_order_acquire);
 
 	if (t < b)
 	{
-		Job *job = jobDeque[t & jobSystemJobCountMask];
+		Job *job = jobDeque[t & jobSystemJobCountMask].load(std::memory_order_relaxed);
 
-		if (!std::atomic_compare_exchange_weak(&top, &t, t + 1))
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
 			return nullptr;
 
 		return job;
@@ -81,65 +138,180 @@ Job *JobSystemWorker::findJob()
 {
 	Job *job = pop();
 
-	if (job == nullptr && jobSystemParent->getWorkerCount() > 1)
+	if (job == nullptr)
 	{
-		size_t stealThreadIndex = 0;
-		
-		while ((stealThreadIndex = rand() % jobSystemParent->getWorkerCount()) == workerIndex);
+		const size_t workerCount = jobSystemParent->getWorkerCount();
 
-		if ((job = jobSystemParent->workers[stealThreadIndex]->steal()) != nullptr)
-			return job;
+		// Try every other worker once, starting from a random one so that thieves spread out
+		const size_t firstVictimIndex = size_t(nextRandom() % workerCount);
+
+		for (size_t i = 0; i < workerCount && job == nullptr; i++)
+		{
+			const size_t victimIndex = (firstVictimIndex + i) % workerCount;
+
+			if (victimIndex != workerIndex)
+				job = stealJobs(jobSystemParent->workers[victimIndex]);
+		}
+	}
+
+	if (job != nullptr)
+		jobSystemParent->availableJobs.fetch_sub(1, std::memory_order_relaxed);
 
+	return job;
+}
+
+Job *JobSystemWorker::stealJobs(JobSystemWorker *victim)
+{
+	stealAttempts.fetch_add(1, std::memory_order_relaxed);
+
+	Job *job = victim->steal();
+
+	if (job == nullptr)
 		return nullptr;
+
+	// Take up to half of what's left as well, so a starving worker doesn't have to come back for every job. They go in this
+	// worker's own deque, which is empty or else there'd have been nothing to steal for
+	const int64_t victimJobCount = victim->bottom.load(std::memory_order_relaxed) - victim->top.load(std::memory_order_relaxed);
+	const int64_t stealBatchSize = std::min<int64_t>(victimJobCount / 2, jobSystemMaxStealBatch - 1);
+	uint64_t stolenJobCount = 1;
+
+	for (int64_t i = 0; i < stealBatchSize; i++)
+	{
+		Job *extraJob = victim->steal();
+
+		if (extraJob == nullptr)
+			break;
+
+		stolenJobCount++;
+
+		// The job stays counted in availableJobs, it's just moved
+		if (!push(extraJob))
+		{
+			jobSystemParent->availableJobs.fetch_sub(1, std::memory_order_relaxed);
+			executeJob(extraJob);
+		}
 	}
 
+	stealSuccesses.fetch_add(1, std::memory_order_relaxed);
+	stolenJobs.fetch_add(stolenJobCount, std::memory_order_relaxed);
+
+	JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_STEAL, uint32_t(stolenJobCount));
+
 	return job;
 }
 
+uint64_t JobSystemWorker::nextRandom()
+{
+	// xorshift64
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+
+	return randomState;
+}
+
 void JobSystemWorker::threadMainFunction()
 {
+	JobSystem::currentWorker = this;
+
+	// Not fatal, the worker just runs wherever the OS puts it. Written out in one go, as every worker starts at the same time
+	if (!affinityCPUs.empty() && !setCurrentThreadAffinity(affinityCPUs))
+		std::cout << ("Failed to pin job system worker " + std::to_string(workerIndex) + " to its CPUs, it's left unpinned\n") << std::flush;
+
+	allocateJobMemory();
+
 	Job *job = nullptr;
+	bool idle = false;
+
 	while (!shouldShutdown)
 	{
+		if (active && (job = findJob()) != nullptr)
 		{
-			uint64_t &availableJobs = jobSystemParent->availableJobs;
-			std::atomic<bool> &varShouldShutdown = shouldShutdown;
+			if (idle)
+				JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_IDLE_END);
 
-			std::unique_lock<std::mutex> lck(jobSystemParent->availableJobs_mutex);
-			jobSystemParent->availableJobs_cond.wait(lck, [&availableJobs, &varShouldShutdown] { return availableJobs > 0 || varShouldShutdown; });
-		}
+			idle = false;
 
-		if (active && (job = findJob()) != nullptr)
 			executeJob(job);
-		else
-			std::this_thread::yield();
+			continue;
+		}
+
+		if (!idle)
+			JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_IDLE_BEGIN);
+
+		idle = true;
+
+		// Spin for a bit in case more work shows up soon, then park until a job is run
+		uint32_t spin = 0;
+
+		while (spin < jobSystemIdleSpinCount && jobSystemParent->availableJobs.load(std::memory_order_relaxed) <= 0 && !shouldShutdown)
+		{
+			jobSystemCpuRelax();
+			spin++;
+		}
+
+		if (spin < jobSystemIdleSpinCount)
+			continue;
+
+		const uint64_t idleKey = jobSystemParent->idleWorkers.prepareWait();
+
+		if (jobSystemParent->availableJobs.load(std::memory_order_seq_cst) > 0 || shouldShutdown)
+			continue;
+
+		JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_PARK_BEGIN);
+		jobSystemParent->idleWorkers.commitWait(idleKey);
+		JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_PARK_END);
 	}
 }
 
 void JobSystemWorker::executeJob(Job *job)
 {
+	JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_JOB_BEGIN, uint32_t(std::max<int64_t>(bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed), 0)));
+
 	if (job->jobFunction != nullptr)
 		(job->jobFunction)(job);
 
 	finishJob(job);
+
+	JOBSYSTEM_TRACE(this, JOB_SYSTEM_TRACE_EVENT_JOB_END);
 }
 
 void JobSystemWorker::finishJob(Job *job)
 {
+	// Once unfinishedJobs reaches 0 the owning worker may reallocate the job, so read everything needed beforehand
+	Job *parent = job->parent;
 	const uint64_t unfinishedJobs = --job->unfinishedJobs;
 
-	if (job->parent == nullptr)
+	if (unfinishedJobs == 0)
 	{
-		std::lock_guard<std::mutex> lck(jobSystemParent->availableJobs_mutex);
-		jobSystemParent->availableJobs--;
+		// Pairs with waitForJobs() registering as a waiter before re-checking unfinishedJobs
+		if (job->waitingThreads.load(std::memory_order_seq_cst) > 0)
+			jobSystemParent->finishedJobs.notifyAll();
+
+		if (parent != nullptr)
+			finishJob(parent);
 	}
-	
-	if (unfinishedJobs == 0 && job->parent != nullptr)
-		finishJob(job->parent);
 }
 
 Job *JobSystemWorker::allocateJob()
 {
-	const uint64_t index = allocatedJobs++;
-	return &jobPool[index & (jobSystemMaxJobCount - 1u)];
+	// Only this worker allocates from its pool, so the only thing to worry about is handing out a slot that's still in use. Jobs
+	// usually finish in roughly the order they were allocated, so the next slot is almost always free, and when it isn't the
+	// live ones are skipped over
+	for (uint64_t i = 0; i < jobSystemMaxJobCount; i++)
+	{
+		Job *job = &jobPool[allocatedJobs++ & jobSystemJobCountMask];
+
+		// A job is live until it and its children have finished, and nobody is parked waiting on it anymore
+		if (job->unfinishedJobs.load(std::memory_order_acquire) == 0 && job->waitingThreads.load(std::memory_order_acquire) == 0)
+		{
+			// Before the caller sets unfinishedJobs, so a waiter that sees the new job's unfinishedJobs sees the new generation too
+			job->generation.fetch_add(1, std::memory_order_relaxed);
+
+			return job;
+		}
+	}
+
+	throw std::runtime_error("A job system worker ran out of jobs, more than " + std::to_string(jobSystemMaxJobCount) + " are unfinished");
+	return nullptr;
 }
\ No newline at end of file
@@ -5,9 +5,28 @@
 #include <mutex>
 #include <thread>
 #include <condition_variable>
+#include <vector>
+
+#include <JobSystemTrace.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
 
 constexpr uint64_t jobSystemMaxJobCount = 8192; // ALWAYS keep as a power of 2
 constexpr uint64_t jobSystemJobCountMask = jobSystemMaxJobCount - 1u;
+constexpr uint32_t jobSystemIdleSpinCount = 2048; // How many times an idle worker polls for jobs before parking
+constexpr int64_t jobSystemMaxStealBatch = 32; // The most jobs a worker takes from a victim at once
+
+// Hints to the CPU that this is a spin-wait loop
+inline void jobSystemCpuRelax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
 
 class JobSystem;
 struct Job;
@@ -21,18 +40,31 @@ class JobSystemWorker
 
 	std::atomic<bool> shouldShutdown;
 	std::atomic<bool> active;
+	std::atomic<bool> jobMemoryAllocated;
+
+	std::vector<uint32_t> affinityCPUs; // The CPUs the worker thread keeps itself on, empty for any
 
-	JobSystemWorker(JobSystem *jobSystemParentPtr);
+#if JOBSYSTEM_TRACING
+	JobSystemTraceBuffer traceBuffer;
+#endif
+
+	// Only ever incremented by this worker, and read by anyone for statistics
+	std::atomic<uint64_t> stealAttempts; // Victims tried
+	std::atomic<uint64_t> stealSuccesses; // Victims that had at least one job
+	std::atomic<uint64_t> stolenJobs;
+
+	JobSystemWorker(JobSystem *jobSystemParentPtr, size_t workerIndexValue);
 	virtual ~JobSystemWorker();
 
 	Job *allocateJob();
+	void allocateJobMemory(); // Called by the thread that owns the worker, so the memory is local to it
 	Job *findJob();
 
 	void executeJob(Job *job);
 
 	void threadMainFunction();
 
-	void push(Job *job);
+	bool push(Job *job); // Returns false if the deque is full
 	Job *pop();
 	Job *steal();
 
@@ -41,14 +73,20 @@ class JobSystemWorker
 	JobSystem *jobSystemParent;
 
 	Job *jobPool;
-	Job **jobDeque;
+	std::atomic<Job*> *jobDeque;
 
 	uint64_t allocatedJobs;
+	uint64_t randomState;
 
 	std::atomic<int64_t> bottom;
 	std::atomic<int64_t> top;
 
 	void finishJob(Job *job);
+
+	Job *stealJobs(JobSystemWorker *victim);
+	uint64_t nextRandom();
+
+	friend class JobSystem;
 };
 
 #endif /* UTIL_JOBSYSTEMWORKER_H_ */
\ No newline at end of file
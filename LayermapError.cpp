@@ -0,0 +1,136 @@
+#include "LayermapError.h"
+
+#include <SIMDSupport.h>
+
+static inline float computeLayermapPixelError(float layerCount, float aboveLayerCount, float targetLayers)
+{
+	const float layerDelta = targetLayers - layerCount;
+	const float smoothnessDelta = layerCount - aboveLayerCount;
+	const float layerDeltaSqr = layerDelta * layerDelta;
+	const float smoothnessDeltaSqr = smoothnessDelta * smoothnessDelta;
+
+	return layerDeltaSqr * layerDeltaSqr + smoothnessDeltaSqr * smoothnessDeltaSqr;
+}
+
+static float computeLayermapRowError_scalar(const uint16_t *row, const uint16_t *aboveRow, uint32_t columnStride, uint32_t columnCount, float targetLayers)
+{
+	float rowError = 0.0f;
+
+	for (uint32_t c = 0; c < columnCount; c++)
+		rowError += computeLayermapPixelError(float(row[c * columnStride]), float(aboveRow[c * columnStride]), targetLayers);
+
+	return rowError;
+}
+
+#if SIMD_SUPPORT_X86
+
+SIMD_TARGET_SSE41 static inline __m128 computeLayermapPixelError_sse41(__m128i layerCount, __m128i aboveLayerCount, __m128 targetLayers)
+{
+	const __m128 layers = _mm_cvtepi32_ps(layerCount);
+	const __m128 layerDelta = _mm_sub_ps(targetLayers, layers);
+	const __m128 smoothnessDelta = _mm_sub_ps(layers, _mm_cvtepi32_ps(aboveLayerCount));
+	const __m128 layerDeltaSqr = _mm_mul_ps(layerDelta, layerDelta);
+	const __m128 smoothnessDeltaSqr = _mm_mul_ps(smoothnessDelta, smoothnessDelta);
+
+	return _mm_add_ps(_mm_mul_ps(layerDeltaSqr, layerDeltaSqr), _mm_mul_ps(smoothnessDeltaSqr, smoothnessDeltaSqr));
+}
+
+SIMD_TARGET_SSE41 static float computeLayermapRowError_sse41(const uint16_t *row, const uint16_t *aboveRow, uint32_t columnStride, uint32_t columnCount, float targetLayers)
+{
+	const __m128 targetLayersVec = _mm_set1_ps(targetLayers);
+	__m128 rowError = _mm_setzero_ps();
+	uint32_t c = 0;
+
+	if (columnStride == 1)
+	{
+		for (; c + 4 <= columnCount; c += 4)
+		{
+			const __m128i layerCount = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + c)));
+			const __m128i aboveLayerCount = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(aboveRow + c)));
+
+			rowError = _mm_add_ps(rowError, computeLayermapPixelError_sse41(layerCount, aboveLayerCount, targetLayersVec));
+		}
+	}
+	else
+	{
+		for (; c + 4 <= columnCount; c += 4)
+		{
+			const uint16_t *columns = row + c * columnStride, *aboveColumns = aboveRow + c * columnStride;
+			const __m128i layerCount = _mm_setr_epi32(columns[0], columns[columnStride], columns[columnStride * 2], columns[columnStride * 3]);
+			const __m128i aboveLayerCount = _mm_setr_epi32(aboveColumns[0], aboveColumns[columnStride], aboveColumns[columnStride * 2], aboveColumns[columnStride * 3]);
+
+			rowError = _mm_add_ps(rowError, computeLayermapPixelError_sse41(layerCount, aboveLayerCount, targetLayersVec));
+		}
+	}
+
+	rowError = _mm_hadd_ps(rowError, rowError);
+	rowError = _mm_hadd_ps(rowError, rowError);
+
+	return _mm_cvtss_f32(rowError) + computeLayermapRowError_scalar(row + c * columnStride, aboveRow + c * columnStride, columnStride, columnCount - c, targetLayers);
+}
+
+SIMD_TARGET_AVX2 static inline __m256 computeLayermapPixelError_avx2(__m256i layerCount, __m256i aboveLayerCount, __m256 targetLayers)
+{
+	const __m256 layers = _mm256_cvtepi32_ps(layerCount);
+	const __m256 layerDelta = _mm256_sub_ps(targetLayers, layers);
+	const __m256 smoothnessDelta = _mm256_sub_ps(layers, _mm256_cvtepi32_ps(aboveLayerCount));
+	const __m256 layerDeltaSqr = _mm256_mul_ps(layerDelta, layerDelta);
+	const __m256 smoothnessDeltaSqr = _mm256_mul_ps(smoothnessDelta, smoothnessDelta);
+
+	return _mm256_add_ps(_mm256_mul_ps(layerDeltaSqr, layerDeltaSqr), _mm256_mul_ps(smoothnessDeltaSqr, smoothnessDeltaSqr));
+}
+
+SIMD_TARGET_AVX2 static float computeLayermapRowError_avx2(const uint16_t *row, const uint16_t *aboveRow, uint32_t columnStride, uint32_t columnCount, float targetLayers)
+{
+	const __m256 targetLayersVec = _mm256_set1_ps(targetLayers);
+	__m256 rowError = _mm256_setzero_ps();
+	uint32_t c = 0;
+
+	if (columnStride == 1)
+	{
+		for (; c + 8 <= columnCount; c += 8)
+		{
+			const __m256i layerCount = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + c)));
+			const __m256i aboveLayerCount = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(aboveRow + c)));
+
+			rowError = _mm256_add_ps(rowError, computeLayermapPixelError_avx2(layerCount, aboveLayerCount, targetLayersVec));
+		}
+	}
+	else
+	{
+		// There's no 16 bit gather, and a 32 bit one could read past the end of the layermap
+		for (; c + 8 <= columnCount; c += 8)
+		{
+			const uint16_t *columns = row + c * columnStride, *aboveColumns = aboveRow + c * columnStride;
+			const __m256i layerCount = _mm256_setr_epi32(columns[0], columns[columnStride], columns[columnStride * 2], columns[columnStride * 3],
+				columns[columnStride * 4], columns[columnStride * 5], columns[columnStride * 6], columns[columnStride * 7]);
+			const __m256i aboveLayerCount = _mm256_setr_epi32(aboveColumns[0], aboveColumns[columnStride], aboveColumns[columnStride * 2], aboveColumns[columnStride * 3],
+				aboveColumns[columnStride * 4], aboveColumns[columnStride * 5], aboveColumns[columnStride * 6], aboveColumns[columnStride * 7]);
+
+			rowError = _mm256_add_ps(rowError, computeLayermapPixelError_avx2(layerCount, aboveLayerCount, targetLayersVec));
+		}
+	}
+
+	__m128 rowErrorHalf = _mm_add_ps(_mm256_castps256_ps128(rowError), _mm256_extractf128_ps(rowError, 1));
+	rowErrorHalf = _mm_hadd_ps(rowErrorHalf, rowErrorHalf);
+	rowErrorHalf = _mm_hadd_ps(rowErrorHalf, rowErrorHalf);
+
+	return _mm_cvtss_f32(rowErrorHalf) + computeLayermapRowError_scalar(row + c * columnStride, aboveRow + c * columnStride, columnStride, columnCount - c, targetLayers);
+}
+
+#endif
+
+float computeLayermapRowError(const uint16_t *row, const uint16_t *aboveRow, uint32_t columnStride, uint32_t columnCount, float targetLayers)
+{
+	switch (getSIMDPath())
+	{
+#if SIMD_SUPPORT_X86
+		case SIMD_PATH_AVX2:
+			return computeLayermapRowError_avx2(row, aboveRow, columnStride, columnCount, targetLayers);
+		case SIMD_PATH_SSE41:
+			return computeLayermapRowError_sse41(row, aboveRow, columnStride, columnCount, targetLayers);
+#endif
+		default:
+			return computeLayermapRowError_scalar(row, aboveRow, columnStride, columnCount, targetLayers);
+	}
+}
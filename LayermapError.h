@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Computes the summed error of one layermap row for computeLayermapError(), over "columnCount" columns spaced "columnStride" pixels apart.
+Each column adds (targetLayers - layers)^4 + (layers - layersAbove)^4, computed as squared squares. The path is picked by getSIMDPath(),
+a contiguous row (columnStride == 1) is loaded directly, otherwise the columns are gathered.
+
+@param[in] aboveRow The row above "row", or "row" itself for the first row
+*/
+float computeLayermapRowError(const uint16_t *row, const uint16_t *aboveRow, uint32_t columnStride, uint32_t columnCount, float targetLayers);
@@ -19,6 +19,7 @@
 using json = nlohmann::json;
 
 #include <JobSystem.h>
+#include <JobSystemBenchmark.h>
 #include <ShellSimulation.h>
 #include <EvolutionSimulation.h>
 
@@ -34,6 +35,19 @@ std::string inputConfigFile = "sim-config.json";
 std::string inputShellConfigFile = "shell-config.json";
 
 bool findTapingConfig = false;
+bool testJobSystem = false;
+std::string jobSystemTraceFile;
+bool benchmarkJobSystem = false;
+std::string jobSystemBenchmarkFile;
+std::string resumeSnapshotFile; // When not empty, --find continues from the population snapshot in this file
+uint32_t islandIndex = 0;
+uint32_t islandCount = 1;
+std::string islandName = "/shell-islands";
+
+// Override the "JobSystemConfig" entry of the simulation config when not -1
+int32_t workerCountOverride = -1;
+int32_t workersPerNumaNodeOverride = -1;
+int32_t pinWorkersOverride = -1;
 int32_t calcError = -1; // When not searching, computes and prints the error of the computed layermap, if -1 no error is calculated, if positive then that is the target number of layers
 
 void parseCommandLineArgs(int argc, char *argv[]);
@@ -43,22 +57,60 @@ void writeOutput(std::string file, OutputType type, uint16_t *layermapImage, uin
 ShellConfig loadShellConfig(const std::string &file);
 SimulationConfig loadSimulationConfig(const std::string &file);
 EvolutionConfig loadEvolutionConfig(const std::string &file);
+JobSystemConfig loadJobSystemConfig(const std::string &file);
 
 int main(int argc, char *argv[])
 {
 	parseCommandLineArgs(argc, argv);
 
-	std::unique_ptr<JobSystem> jobSystemInstance(new JobSystem(16));
+	JobSystemConfig jobSystemConfig = loadJobSystemConfig(inputConfigFile);
+
+	if (workerCountOverride >= 0)
+		jobSystemConfig.maxWorkerCount = uint32_t(workerCountOverride);
+
+	if (workersPerNumaNodeOverride >= 0)
+		jobSystemConfig.workersPerNumaNode = uint32_t(workersPerNumaNodeOverride);
+
+	if (pinWorkersOverride >= 0)
+		jobSystemConfig.pinWorkers = pinWorkersOverride > 0;
+
+	// Benchmarks create their own job systems, so this has to happen before the main thread is registered with one
+	if (benchmarkJobSystem)
+	{
+		if (workerCountOverride < 0 && jobSystemConfig.workersPerNumaNode == 0)
+			jobSystemConfig.maxWorkerCount = std::max<uint32_t>(std::thread::hardware_concurrency(), 2);
+
+		runJobSystemBenchmarks(jobSystemConfig, jobSystemBenchmarkFile);
+		return 0;
+	}
+
+	std::unique_ptr<JobSystem> jobSystemInstance(new JobSystem(jobSystemConfig));
 	JobSystem::setInstance(jobSystemInstance.get());
 
+	if (!jobSystemTraceFile.empty() && !jobSystemInstance->setTraceFile(jobSystemTraceFile))
+		std::cout << "Job system tracing isn't built in, rebuild with JOBSYSTEM_TRACING=1 to write \"" << jobSystemTraceFile << "\"" << std::endl;
+
+	if (testJobSystem)
+	{
+		jobSystemInstance->test();
+		return 0;
+	}
+
 	SimulationConfig simConfig = loadSimulationConfig(inputConfigFile);
 
 	if (findTapingConfig)
 	{
 		EvolutionConfig evolutionConfig = loadEvolutionConfig(inputConfigFile);
+		evolutionConfig.islandIndex = islandIndex;
+		evolutionConfig.islandCount = islandCount;
+		evolutionConfig.islandName = islandName;
+
+		// Each island breeds from its own random streams
+		evolutionConfig.randomSeed += uint64_t(islandIndex) * 0x9E3779B97F4A7C15ull;
+
 		std::unique_ptr<EvolutionSimulation> simulation(new EvolutionSimulation());
 
-		simulation->simulateEvolution(simConfig, evolutionConfig);
+		simulation->simulateEvolution(simConfig, evolutionConfig, resumeSnapshotFile);
 	}
 	else
 	{
@@ -66,9 +118,8 @@ int main(int argc, char *argv[])
 		std::unique_ptr<ShellSimulation> simulation(new ShellSimulation());
 
 		std::vector<uint16_t> layermapImage(simConfig.layermapSize * simConfig.layermapSize, 0);
-		std::vector<uint16_t> scratchLayermapImage(simConfig.layermapSize * simConfig.layermapSize, 0);
 
-		simulation->simulateTaping(shellConfig, simConfig, layermapImage.data(), scratchLayermapImage.data());
+		simulation->simulateTaping(shellConfig, simConfig, layermapImage.data());
 
 		writeOutput("heatmap.png", OUTPUT_TYPE_HEATMAP_PNG, layermapImage.data(), simConfig.layermapSize);
 		writeOutput("layermap.png", OUTPUT_TYPE_LAYERMAP_PNG, layermapImage.data(), simConfig.layermapSize);
@@ -99,6 +150,53 @@ void parseCommandLineArgs(int argc, char *argv[])
 		{
 			findTapingConfig = true;
 		}
+		else if (strcmp(argv[i], "--test-jobs") == 0)
+		{
+			testJobSystem = true;
+		}
+		else if (strcmp(argv[i], "--pin-workers") == 0)
+		{
+			pinWorkersOverride = 1;
+		}
+		else if (strcmp(argv[i], "--bench-jobs") == 0 && i < argc - 1)
+		{
+			benchmarkJobSystem = true;
+			jobSystemBenchmarkFile = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "--resume") == 0 && i < argc - 1)
+		{
+			findTapingConfig = true;
+			resumeSnapshotFile = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "--island") == 0 && i < argc - 2)
+		{
+			findTapingConfig = true;
+			islandIndex = uint32_t(std::stoi(argv[i + 1]));
+			islandCount = uint32_t(std::stoi(argv[i + 2]));
+			i += 2;
+		}
+		else if (strcmp(argv[i], "--island-name") == 0 && i < argc - 1)
+		{
+			islandName = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i < argc - 1)
+		{
+			jobSystemTraceFile = argv[i + 1];
+			i++;
+		}
+		else if (strcmp(argv[i], "--workers") == 0 && i < argc - 1)
+		{
+			workerCountOverride = std::stoi(argv[i + 1]);
+			i++;
+		}
+		else if (strcmp(argv[i], "--workers-per-node") == 0 && i < argc - 1)
+		{
+			workersPerNumaNodeOverride = std::stoi(argv[i + 1]);
+			i++;
+		}
 		else if (strcmp(argv[i], "-i") == 0 && i < argc - 1)
 		{
 			inputConfigFile = argv[i + 1];
@@ -121,6 +219,15 @@ void printHelp()
 {
 	std::cout << "--help\t\tBring up this help menu" << std::endl;
 	std::cout << "--find\t\tRun an algorithm to find the best taping method given the configured parameters" << std::endl;
+	std::cout << "--resume <file>\tContinues a --find run from the population snapshot in <file>, written every \"snapshotInterval\" generations to \"snapshotFile\"" << std::endl;
+	std::cout << "--island <i> <n>\tRuns --find as island <i> (from 0) of <n>, each a separate process migrating its best members to the next every \"migrationInterval\" generations" << std::endl;
+	std::cout << "--island-name <name>\tThe shared memory the islands migrate through, defaults to \"/shell-islands\", different for each concurrent set of islands" << std::endl;
+	std::cout << "--test-jobs\tStress tests the job system and exits" << std::endl;
+	std::cout << "--workers <n>\tUses up to <n> threads for jobs (including the main thread), defaults to 16" << std::endl;
+	std::cout << "--workers-per-node <n>\tCreates <n> worker threads on each NUMA node instead, keeping each on its node" << std::endl;
+	std::cout << "--pin-workers\tPins each worker thread to its own core" << std::endl;
+	std::cout << "--bench-jobs <file>\tBenchmarks the job system from 2 (the fewest it can have) up to --workers workers (all CPUs by default), writes the results to <file> as CSV or JSON (.json) and exits" << std::endl;
+	std::cout << "--trace <file>\tWrites a Chrome trace of the job system's workers to <file> on exit (needs JOBSYSTEM_TRACING=1)" << std::endl;
 	std::cout << "-i <file>\tLoads <file> as the simulation config file, defaults to \"shell-config.json\"" << std::endl;
 	std::cout << "-s <file>\tLoads <file> as the shell config file, defaults to \"shell-config.json\"" << std::endl;
 	std::cout << "-e <layers>\tCalculates the error of the shell config given a number of layers" << std::endl;
@@ -280,6 +387,12 @@ EvolutionConfig loadEvolutionConfig(const std::string &file)
 		evolutionConfig.randomPercentage = configEntry["randomPercentage"];
 		evolutionConfig.maxMutationPercentage = configEntry["maxMutationPercentage"];
 		evolutionConfig.minShellArmAngle = configEntry["minShellArmAngle"];
+		evolutionConfig.fitnessCacheEntries = configEntry.contains("fitnessCacheEntries") ? uint32_t(configEntry["fitnessCacheEntries"]) : 65536;
+		evolutionConfig.randomSeed = configEntry.contains("randomSeed") ? uint64_t(configEntry["randomSeed"]) : 1;
+		evolutionConfig.snapshotInterval = configEntry.contains("snapshotInterval") ? uint32_t(configEntry["snapshotInterval"]) : 10;
+		evolutionConfig.snapshotFile = configEntry.contains("snapshotFile") ? std::string(configEntry["snapshotFile"]) : "population-snapshot.bin";
+		evolutionConfig.migrationInterval = configEntry.contains("migrationInterval") ? uint32_t(configEntry["migrationInterval"]) : 10;
+		evolutionConfig.migrantCount = configEntry.contains("migrantCount") ? uint32_t(configEntry["migrantCount"]) : 4;
 		//volutionConfig.maxIterations = configEntry["maxIterations"];
 
 		for (auto &elem : configEntry["minShellArmAngles"])
@@ -293,6 +406,20 @@ EvolutionConfig loadEvolutionConfig(const std::string &file)
 
 		for (auto &elem : configEntry["maxShellStepperSpeedFraction"])
 			evolutionConfig.maxShellStepperSpeed.push_back(elem);
+
+		// The elite and random members are carved out of the population, the rest are bred
+		if (evolutionConfig.populationSize == 0 || evolutionConfig.elitePercentage < 0 || evolutionConfig.randomPercentage < 0 || evolutionConfig.elitePercentage + evolutionConfig.randomPercentage > 1)
+		{
+			std::cout << "\"elitePercentage\" and \"randomPercentage\" can't add up to more than 1, with a \"populationSize\" of at least 1!" << std::endl;
+			exit(-1);
+		}
+
+		// Migrants only replace random members, so with fewer of those an island would silently receive fewer or none
+		if (islandCount > 1 && evolutionConfig.migrationInterval > 0 && uint32_t(evolutionConfig.populationSize * evolutionConfig.randomPercentage) < evolutionConfig.migrantCount)
+		{
+			std::cout << "\"populationSize\" * \"randomPercentage\" has to be at least \"migrantCount\" (" << evolutionConfig.migrantCount << ") for --island, migrants replace the random members!" << std::endl;
+			exit(-1);
+		}
 	}
 	else
 	{
@@ -302,4 +429,51 @@ EvolutionConfig loadEvolutionConfig(const std::string &file)
 	fileStream.close();
 
 	return evolutionConfig;
+}
+
+JobSystemConfig loadJobSystemConfig(const std::string &file)
+{
+	JobSystemConfig jobSystemConfig = {};
+	jobSystemConfig.maxWorkerCount = 16;
+	jobSystemConfig.maxExternalThreadCount = 1;
+	jobSystemConfig.pinWorkers = false;
+	jobSystemConfig.workersPerNumaNode = 0;
+
+	// Everything here is optional, so no simulation config just means the defaults (a missing one is reported when the rest is loaded)
+	std::ifstream fileStream(file);
+
+	if (!fileStream.is_open())
+		return jobSystemConfig;
+
+	json jsonConfig;
+
+	try
+	{
+		fileStream >> jsonConfig;
+	}
+	catch (std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+		fileStream.close();
+		exit(-1);
+	}
+
+	// The whole entry and each of its values are optional
+	if (jsonConfig.contains("JobSystemConfig"))
+	{
+		json configEntry = jsonConfig["JobSystemConfig"];
+
+		if (configEntry.contains("maxWorkerCount"))
+			jobSystemConfig.maxWorkerCount = configEntry["maxWorkerCount"];
+
+		if (configEntry.contains("pinWorkers"))
+			jobSystemConfig.pinWorkers = configEntry["pinWorkers"];
+
+		if (configEntry.contains("workersPerNumaNode"))
+			jobSystemConfig.workersPerNumaNode = configEntry["workersPerNumaNode"];
+	}
+
+	fileStream.close();
+
+	return jobSystemConfig;
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Philox4x32-10, a counter based random number generator ("Parallel Random Numbers: As Easy as 1, 2, 3", Salmon et al. 2011).
+Every (key, counter) pair maps to 4 random numbers, so independent streams are just different keys/counters, and a stream's
+numbers don't depend on which thread draws them or in what order streams are used.
+
+A stream is keyed by the seed and counts up from the stream's (streamA, streamB) coordinates, e.g. (generation, member).
+*/
+class PhiloxRandom
+{
+public:
+
+	PhiloxRandom(uint64_t seed, uint32_t streamA, uint32_t streamB)
+	{
+		key[0] = uint32_t(seed);
+		key[1] = uint32_t(seed >> 32);
+
+		counter[0] = 0;
+		counter[1] = 0;
+		counter[2] = streamA;
+		counter[3] = streamB;
+
+		outputIndex = 4;
+	}
+
+	uint32_t next()
+	{
+		if (outputIndex == 4)
+		{
+			generateBlock();
+			outputIndex = 0;
+		}
+
+		return output[outputIndex++];
+	}
+
+	// In [0, 1]
+	float nextFloat()
+	{
+		return float(next() >> 8) / float((1u << 24) - 1u);
+	}
+
+private:
+
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t output[4];
+	uint32_t outputIndex;
+
+	static void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo)
+	{
+		const uint64_t product = uint64_t(a) * uint64_t(b);
+
+		hi = uint32_t(product >> 32);
+		lo = uint32_t(product);
+	}
+
+	void generateBlock()
+	{
+		uint32_t block[4] = {counter[0], counter[1], counter[2], counter[3]};
+		uint32_t roundKey[2] = {key[0], key[1]};
+
+		for (uint32_t round = 0; round < 10; round++)
+		{
+			uint32_t hi0, lo0, hi1, lo1;
+			mulhilo(0xD2511F53u, block[0], hi0, lo0);
+			mulhilo(0xCD9E8D57u, block[2], hi1, lo1);
+
+			const uint32_t nextBlock[4] = {hi1 ^ block[1] ^ roundKey[0], lo1, hi0 ^ block[3] ^ roundKey[1], lo0};
+
+			block[0] = nextBlock[0];
+			block[1] = nextBlock[1];
+			block[2] = nextBlock[2];
+			block[3] = nextBlock[3];
+
+			roundKey[0] += 0x9E3779B9u;
+			roundKey[1] += 0xBB67AE85u;
+		}
+
+		output[0] = block[0];
+		output[1] = block[1];
+		output[2] = block[2];
+		output[3] = block[3];
+
+		// 64 bits of counter per stream is far more than any stream draws
+		if (++counter[0] == 0)
+			counter[1]++;
+	}
+};
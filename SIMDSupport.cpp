@@ -0,0 +1,107 @@
+#include "SIMDSupport.h"
+
+#include <atomic>
+
+#if SIMD_SUPPORT_X86 && defined(_MSC_VER)
+#include <intrin.h>
+
+static bool cpuSupportsSSE41()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+
+	return (cpuInfo[2] & (1 << 19)) != 0;
+}
+
+static bool cpuSupportsAVX2()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+
+	if (cpuInfo[0] < 7)
+		return false;
+
+	// The OS also has to save the YMM registers on context switches
+	__cpuid(cpuInfo, 1);
+
+	if ((cpuInfo[2] & (1 << 27)) == 0 || (cpuInfo[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(cpuInfo, 7, 0);
+
+	return (cpuInfo[1] & (1 << 5)) != 0;
+}
+
+#elif SIMD_SUPPORT_X86
+
+static bool cpuSupportsSSE41()
+{
+	return __builtin_cpu_supports("sse4.1");
+}
+
+static bool cpuSupportsAVX2()
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+static SIMDPath findWidestSIMDPath()
+{
+	if (isSIMDPathSupported(SIMD_PATH_AVX2))
+		return SIMD_PATH_AVX2;
+
+	if (isSIMDPathSupported(SIMD_PATH_SSE41))
+		return SIMD_PATH_SSE41;
+
+	return SIMD_PATH_SCALAR;
+}
+
+static std::atomic<SIMDPath> &currentSIMDPath()
+{
+	static std::atomic<SIMDPath> path(findWidestSIMDPath());
+
+	return path;
+}
+
+bool isSIMDPathSupported(SIMDPath path)
+{
+	switch (path)
+	{
+		case SIMD_PATH_SCALAR:
+			return true;
+#if SIMD_SUPPORT_X86
+		case SIMD_PATH_SSE41:
+			return cpuSupportsSSE41();
+		case SIMD_PATH_AVX2:
+			return cpuSupportsAVX2();
+#endif
+		default:
+			return false;
+	}
+}
+
+SIMDPath getSIMDPath()
+{
+	return currentSIMDPath().load(std::memory_order_relaxed);
+}
+
+void setSIMDPath(SIMDPath path)
+{
+	currentSIMDPath() = isSIMDPathSupported(path) ? path : findWidestSIMDPath();
+}
+
+const char *getSIMDPathName(SIMDPath path)
+{
+	switch (path)
+	{
+		case SIMD_PATH_SCALAR:
+			return "scalar";
+		case SIMD_PATH_SSE41:
+			return "SSE4.1";
+		case SIMD_PATH_AVX2:
+			return "AVX2";
+		default:
+			return "unknown";
+	}
+}
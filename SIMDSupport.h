@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_SUPPORT_X86 1
+#include <immintrin.h>
+
+// GCC & clang need functions using instructions beyond the compile target marked, MSVC allows them anywhere
+#if defined(_MSC_VER)
+#define SIMD_TARGET_SSE41
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define SIMD_SUPPORT_X86 0
+#endif
+
+enum SIMDPath
+{
+	SIMD_PATH_SCALAR,
+	SIMD_PATH_SSE41,
+	SIMD_PATH_AVX2
+};
+
+bool isSIMDPathSupported(SIMDPath path);
+
+// Returns the path used by the vectorized simulation kernels, by default the widest one the CPU supports
+SIMDPath getSIMDPath();
+
+// Forces a path for all the kernels, falls back to the widest supported path if the CPU doesn't support the requested one
+void setSIMDPath(SIMDPath path);
+
+const char *getSIMDPathName(SIMDPath path);
@@ -0,0 +1,213 @@
+#include "ShellProjection.h"
+
+#include <cmath>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <util.h>
+#include <SIMDSupport.h>
+
+// Constants for the atan & asin polynomial approximations (from Cephes' atanf & asinf)
+constexpr float atanRangeReductionThreshold = 0.41421356f; // tan(pi / 8)
+constexpr float atanCoeffs[4] = {8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f};
+constexpr float asinCoeffs[5] = {4.2163199048e-2f, 2.4181311049e-2f, 4.5470025998e-2f, 7.4953002686e-2f, 1.6666752422e-1f};
+
+static void projectTapeSamples_scalar(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, uint32_t sampleCount, uint32_t layermapSize, uint32_t rowPitch, uint32_t *pixelIndices)
+{
+	for (uint32_t i = 0; i < sampleCount; i++)
+	{
+		glm::vec2 uv = convertShellTapeToUV(kernel, sinTape[i], cosTape[i]);
+
+		pixelIndices[i] = uint32_t(uv.y * float(layermapSize - 1)) * rowPitch + uint32_t(uv.x * float(layermapSize - 1));
+	}
+}
+
+#if SIMD_SUPPORT_X86
+
+SIMD_TARGET_SSE41 static inline __m128 atan2_sse41(__m128 y, __m128 x)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 absY = _mm_andnot_ps(signMask, y);
+	const __m128 absX = _mm_andnot_ps(signMask, x);
+
+	// Reduce to atan(a) with a in [0, 1], guarding against 0/0 at the poles
+	const __m128 maxXY = _mm_max_ps(_mm_max_ps(absX, absY), _mm_set1_ps(1e-30f));
+	__m128 a = _mm_div_ps(_mm_min_ps(absX, absY), maxXY);
+
+	const __m128 reduce = _mm_cmpgt_ps(a, _mm_set1_ps(atanRangeReductionThreshold));
+	a = _mm_blendv_ps(a, _mm_div_ps(_mm_sub_ps(a, _mm_set1_ps(1.0f)), _mm_add_ps(a, _mm_set1_ps(1.0f))), reduce);
+
+	const __m128 z = _mm_mul_ps(a, a);
+	__m128 r = _mm_set1_ps(atanCoeffs[0]);
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(atanCoeffs[1]));
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(atanCoeffs[2]));
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(atanCoeffs[3]));
+	r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(r, z), a), a);
+	r = _mm_add_ps(r, _mm_and_ps(reduce, _mm_set1_ps(float(M_PI / 4.0))));
+
+	// Undo the reduction into the correct octant/quadrant
+	r = _mm_blendv_ps(r, _mm_sub_ps(_mm_set1_ps(float(M_PI / 2.0)), r), _mm_cmpgt_ps(absY, absX));
+	r = _mm_blendv_ps(r, _mm_sub_ps(_mm_set1_ps(float(M_PI)), r), _mm_cmplt_ps(x, _mm_setzero_ps()));
+
+	return _mm_xor_ps(r, _mm_and_ps(y, signMask));
+}
+
+SIMD_TARGET_SSE41 static inline __m128 acos_sse41(__m128 x)
+{
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	const __m128 absX = _mm_andnot_ps(signMask, x);
+
+	// For |x| > 0.5, acos(|x|) = 2 * asin(sqrt((1 - |x|) / 2)), otherwise acos(|x|) = pi/2 - asin(|x|)
+	const __m128 nearPole = _mm_cmpgt_ps(absX, _mm_set1_ps(0.5f));
+	const __m128 z = _mm_blendv_ps(_mm_mul_ps(absX, absX), _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(_mm_set1_ps(1.0f), absX)), nearPole);
+	const __m128 a = _mm_blendv_ps(absX, _mm_sqrt_ps(z), nearPole);
+
+	__m128 r = _mm_set1_ps(asinCoeffs[0]);
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(asinCoeffs[1]));
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(asinCoeffs[2]));
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(asinCoeffs[3]));
+	r = _mm_add_ps(_mm_mul_ps(r, z), _mm_set1_ps(asinCoeffs[4]));
+	r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(r, z), a), a);
+
+	r = _mm_blendv_ps(_mm_sub_ps(_mm_set1_ps(float(M_PI / 2.0)), r), _mm_add_ps(r, r), nearPole);
+
+	return _mm_blendv_ps(r, _mm_sub_ps(_mm_set1_ps(float(M_PI)), r), _mm_cmplt_ps(x, _mm_setzero_ps()));
+}
+
+SIMD_TARGET_SSE41 static inline void projectTapeSamples4_sse41(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, __m128 mapScale, __m128i rowPitch, uint32_t *pixelIndices)
+{
+	const __m128 s = _mm_loadu_ps(sinTape);
+	const __m128 c = _mm_loadu_ps(cosTape);
+
+	const __m128 dirX = _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(kernel.tapeCenterDir.x)), _mm_mul_ps(s, _mm_set1_ps(kernel.tapeSideDir.x)));
+	const __m128 dirY = _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(kernel.tapeCenterDir.y)), _mm_mul_ps(s, _mm_set1_ps(kernel.tapeSideDir.y)));
+	const __m128 dirZ = _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(kernel.tapeCenterDir.z)), _mm_mul_ps(s, _mm_set1_ps(kernel.tapeSideDir.z)));
+
+	__m128 u = _mm_mul_ps(_mm_add_ps(atan2_sse41(dirX, dirZ), _mm_set1_ps(float(M_PI))), _mm_set1_ps(float(1.0 / M_2PI)));
+	__m128 v = _mm_mul_ps(acos_sse41(dirY), _mm_set1_ps(float(1.0 / M_PI)));
+	u = _mm_min_ps(_mm_max_ps(u, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+	const __m128i pixelX = _mm_cvttps_epi32(_mm_mul_ps(u, mapScale));
+	const __m128i pixelY = _mm_cvttps_epi32(_mm_mul_ps(v, mapScale));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(pixelIndices), _mm_add_epi32(_mm_mullo_epi32(pixelY, rowPitch), pixelX));
+}
+
+SIMD_TARGET_SSE41 static void projectTapeSamples_sse41(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, uint32_t sampleCount, uint32_t layermapSize, uint32_t rowPitch, uint32_t *pixelIndices)
+{
+	const __m128 mapScale = _mm_set1_ps(float(layermapSize - 1));
+	const __m128i rowPitchVec = _mm_set1_epi32(int32_t(rowPitch));
+
+	for (uint32_t i = 0; i < sampleCount; i += 8)
+	{
+		projectTapeSamples4_sse41(kernel, sinTape + i, cosTape + i, mapScale, rowPitchVec, pixelIndices + i);
+		projectTapeSamples4_sse41(kernel, sinTape + i + 4, cosTape + i + 4, mapScale, rowPitchVec, pixelIndices + i + 4);
+	}
+}
+
+SIMD_TARGET_AVX2 static inline __m256 atan2_avx2(__m256 y, __m256 x)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 absY = _mm256_andnot_ps(signMask, y);
+	const __m256 absX = _mm256_andnot_ps(signMask, x);
+
+	// Reduce to atan(a) with a in [0, 1], guarding against 0/0 at the poles
+	const __m256 maxXY = _mm256_max_ps(_mm256_max_ps(absX, absY), _mm256_set1_ps(1e-30f));
+	__m256 a = _mm256_div_ps(_mm256_min_ps(absX, absY), maxXY);
+
+	const __m256 reduce = _mm256_cmp_ps(a, _mm256_set1_ps(atanRangeReductionThreshold), _CMP_GT_OQ);
+	a = _mm256_blendv_ps(a, _mm256_div_ps(_mm256_sub_ps(a, _mm256_set1_ps(1.0f)), _mm256_add_ps(a, _mm256_set1_ps(1.0f))), reduce);
+
+	const __m256 z = _mm256_mul_ps(a, a);
+	__m256 r = _mm256_set1_ps(atanCoeffs[0]);
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(atanCoeffs[1]));
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(atanCoeffs[2]));
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(atanCoeffs[3]));
+	r = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r, z), a), a);
+	r = _mm256_add_ps(r, _mm256_and_ps(reduce, _mm256_set1_ps(float(M_PI / 4.0))));
+
+	// Undo the reduction into the correct octant/quadrant
+	r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(float(M_PI / 2.0)), r), _mm256_cmp_ps(absY, absX, _CMP_GT_OQ));
+	r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(float(M_PI)), r), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+
+	return _mm256_xor_ps(r, _mm256_and_ps(y, signMask));
+}
+
+SIMD_TARGET_AVX2 static inline __m256 acos_avx2(__m256 x)
+{
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+	const __m256 absX = _mm256_andnot_ps(signMask, x);
+
+	// For |x| > 0.5, acos(|x|) = 2 * asin(sqrt((1 - |x|) / 2)), otherwise acos(|x|) = pi/2 - asin(|x|)
+	const __m256 nearPole = _mm256_cmp_ps(absX, _mm256_set1_ps(0.5f), _CMP_GT_OQ);
+	const __m256 z = _mm256_blendv_ps(_mm256_mul_ps(absX, absX), _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_sub_ps(_mm256_set1_ps(1.0f), absX)), nearPole);
+	const __m256 a = _mm256_blendv_ps(absX, _mm256_sqrt_ps(z), nearPole);
+
+	__m256 r = _mm256_set1_ps(asinCoeffs[0]);
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(asinCoeffs[1]));
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(asinCoeffs[2]));
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(asinCoeffs[3]));
+	r = _mm256_add_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(asinCoeffs[4]));
+	r = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(r, z), a), a);
+
+	r = _mm256_blendv_ps(_mm256_sub_ps(_mm256_set1_ps(float(M_PI / 2.0)), r), _mm256_add_ps(r, r), nearPole);
+
+	return _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(float(M_PI)), r), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+}
+
+SIMD_TARGET_AVX2 static inline void projectTapeSamples8_avx2(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, __m256 mapScale, __m256i rowPitch, uint32_t *pixelIndices)
+{
+	const __m256 s = _mm256_loadu_ps(sinTape);
+	const __m256 c = _mm256_loadu_ps(cosTape);
+
+	const __m256 dirX = _mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(kernel.tapeCenterDir.x)), _mm256_mul_ps(s, _mm256_set1_ps(kernel.tapeSideDir.x)));
+	const __m256 dirY = _mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(kernel.tapeCenterDir.y)), _mm256_mul_ps(s, _mm256_set1_ps(kernel.tapeSideDir.y)));
+	const __m256 dirZ = _mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(kernel.tapeCenterDir.z)), _mm256_mul_ps(s, _mm256_set1_ps(kernel.tapeSideDir.z)));
+
+	__m256 u = _mm256_mul_ps(_mm256_add_ps(atan2_avx2(dirX, dirZ), _mm256_set1_ps(float(M_PI))), _mm256_set1_ps(float(1.0 / M_2PI)));
+	__m256 v = _mm256_mul_ps(acos_avx2(dirY), _mm256_set1_ps(float(1.0 / M_PI)));
+	u = _mm256_min_ps(_mm256_max_ps(u, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+
+	const __m256i pixelX = _mm256_cvttps_epi32(_mm256_mul_ps(u, mapScale));
+	const __m256i pixelY = _mm256_cvttps_epi32(_mm256_mul_ps(v, mapScale));
+
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(pixelIndices), _mm256_add_epi32(_mm256_mullo_epi32(pixelY, rowPitch), pixelX));
+}
+
+SIMD_TARGET_AVX2 static void projectTapeSamples_avx2(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, uint32_t sampleCount, uint32_t layermapSize, uint32_t rowPitch, uint32_t *pixelIndices)
+{
+	const __m256 mapScale = _mm256_set1_ps(float(layermapSize - 1));
+	const __m256i rowPitchVec = _mm256_set1_epi32(int32_t(rowPitch));
+
+	for (uint32_t i = 0; i < sampleCount; i += 16)
+	{
+		projectTapeSamples8_avx2(kernel, sinTape + i, cosTape + i, mapScale, rowPitchVec, pixelIndices + i);
+		projectTapeSamples8_avx2(kernel, sinTape + i + 8, cosTape + i + 8, mapScale, rowPitchVec, pixelIndices + i + 8);
+	}
+}
+
+#endif
+
+void projectTapeSamples(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, uint32_t sampleCount, uint32_t layermapSize, uint32_t rowPitch, uint32_t *pixelIndices)
+{
+	switch (getSIMDPath())
+	{
+#if SIMD_SUPPORT_X86
+		case SIMD_PATH_AVX2:
+			projectTapeSamples_avx2(kernel, sinTape, cosTape, sampleCount, layermapSize, rowPitch, pixelIndices);
+			break;
+		case SIMD_PATH_SSE41:
+			projectTapeSamples_sse41(kernel, sinTape, cosTape, sampleCount, layermapSize, rowPitch, pixelIndices);
+			break;
+#endif
+		default:
+			projectTapeSamples_scalar(kernel, sinTape, cosTape, sampleCount, layermapSize, rowPitch, pixelIndices);
+			break;
+	}
+}
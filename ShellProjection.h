@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+struct ShellTapeKernel;
+
+constexpr uint32_t tapeProjectionBatchSize = 16; // The most samples projected at once, sample arrays must be padded to a multiple of this
+
+/*
+Projects the tape samples of a single simulation step to layermap pixel indices, the same as calling convertShellTapeToUV() for each sample.
+The path is picked by getSIMDPath(). The vectorized paths use polynomial atan2/acos approximations (max error ~1e-6 radians), so a sample
+landing right on a pixel boundary may end up in the neighboring pixel compared to the scalar path.
+
+@param[in] sinTape The sin of each tape offset, padded to a multiple of "tapeProjectionBatchSize"
+@param[in] cosTape The cos of each tape offset, padded to a multiple of "tapeProjectionBatchSize"
+@param[in] rowPitch The index distance between rows, "layermapSize" for a layermap index, or 1 << 16 to get the pixel's (y << 16) | x
+@param[out] pixelIndices The layermap index of each sample, must have room for "sampleCount" rounded up to a multiple of "tapeProjectionBatchSize"
+*/
+void projectTapeSamples(const ShellTapeKernel &kernel, const float *sinTape, const float *cosTape, uint32_t sampleCount, uint32_t layermapSize, uint32_t rowPitch, uint32_t *pixelIndices);
+
@@ -1,6 +1,8 @@
 #include "ShellSimulation.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -9,10 +11,14 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include <util.h>
+#include <ShellProjection.h>
+#include <ShellSimulationTables.h>
+#include <LayermapError.h>
 
 ShellSimulation::ShellSimulation()
 {
-
+	errorColumnStride = 0;
+	errorColumnCount = 0;
 }
 
 ShellSimulation::~ShellSimulation()
@@ -21,85 +27,222 @@ ShellSimulation::~ShellSimulation()
 }
 
 /*
-This function actually simulates taping. It does it using matrix math mainly, essentially rotating a matrix by each machine axis to find which pixel needs to have a layer added.
+This function actually simulates taping. It does it using matrix math mainly, essentially rotating by each machine axis to find which pixel needs to have a layer added.
+The rim, arm and shell rotations are composed once per step into a ShellTapeKernel, and each sample across the tape's width is then just a rotation between the
+kernel's two basis vectors (see util.h), projected a batch at a time by projectTapeSamples().
+
+The rim and tape trig comes from the shared ShellSimulationTables, the arm's is computed once per application, and the shell's is advanced each step by
+rotating it by the (constant) shell step, re-anchored once per rim rotation so it doesn't drift.
+
+Coverage within a rim rotation is tracked as one bit per pixel, along with a list of the 64 pixel words that have any bit set, so that merging a rotation into
+the layermap only costs as much as the tape's footprint.
 */
-void ShellSimulation::simulateTaping(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint16_t *layermap, uint16_t *scratchLayermap)
+void ShellSimulation::simulateTaping(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint16_t *layermap)
 {
-	uint32_t currentAngleIndex = 0; // The current angle/application
-	float rimRotations = 0; // Counter of rim rotations, in radians
-	float armRotation = shellConfig.shellArmAngles[currentAngleIndex] * (M_PI / 180.0f); // In radians, 0 = straight up/down
-	float shellRotation = 0;
-
-	const float tapeWidthRadians = (shellConfig.tapeWidth / (shellConfig.shellDiameter * M_PI)) * M_PI;
-	const float radianFillStepSize = M_2PI / (simConfig.layermapSize * simConfig.mapFillPrecisionMult);
+	simulateTapingLayers(shellConfig, simConfig, layermap, false);
+}
 
-	// Add a circle on the top pole denoting the shell chuck
-	const float shellChuckDiameter = shellConfig.shellChuckDiameter;
-	float shellChuckContactAngle = M_2PI * (shellChuckDiameter / (M_PI * shellConfig.shellDiameter));
+uint32_t ShellSimulation::simulateTapingError(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint32_t targetLayers, uint32_t errorCutoff)
+{
+	const uint32_t errorSweepCount = getErrorSweepCount(simConfig);
+	const uint32_t errorSweepStride = simConfig.layermapSize / errorSweepCount;
 
-	// Fill a ring around where the shell chuck is, for reference
-	for (float f = 0; f < M_2PI; f += radianFillStepSize)
+	// Map each pixel column to the error column it's kept in, if any
+	if (errorColumnOfPixelX.size() != simConfig.layermapSize || errorColumnStride != errorSweepStride)
 	{
-		glm::vec2 uv = convertShellChuckToUV(shellChuckContactAngle, f);
+		errorColumnOfPixelX.assign(simConfig.layermapSize, -1);
+		errorColumnStride = errorSweepStride;
+		errorColumnCount = 0;
+
+		for (uint32_t x = 0; x < simConfig.layermapSize; x += errorSweepStride)
+			errorColumnOfPixelX[x] = int32_t(errorColumnCount++);
+	}
+
+	errorColumnLayers.assign(simConfig.layermapSize * errorColumnCount, 0);
+
+	ErrorCutoff cutoff = {};
+	cutoff.targetLayers = targetLayers;
+	cutoff.errorSweepCount = errorSweepCount;
+	cutoff.errorCutoff = errorCutoff;
+
+	simulateTapingLayers(shellConfig, simConfig, errorColumnLayers.data(), true, errorCutoff != UINT32_MAX ? &cutoff : nullptr);
+
+	if (cutoff.exceeded)
+		return cutoff.errorLowerBound;
+
+	return computeLayerError(errorColumnLayers.data(), errorColumnCount, 1, errorColumnCount, simConfig.layermapSize, errorSweepCount, targetLayers);
+}
+
+void ShellSimulation::simulateTapingLayers(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint16_t *layers, bool errorColumnsOnly, ErrorCutoff *cutoff)
+{
+	if (tables == nullptr || !tables->matches(shellConfig, simConfig))
+		tables = ShellSimulationTables::get(shellConfig, simConfig);
 
-		scratchLayermap[uint32_t(uv.y * float(simConfig.layermapSize - 1)) * simConfig.layermapSize + uint32_t(uv.x * float(simConfig.layermapSize - 1))] = 3;
+	const uint32_t stepsPerRimRotation = tables->stepsPerRimRotation;
+	const uint32_t layerCount = errorColumnsOnly ? simConfig.layermapSize * errorColumnCount : simConfig.layermapSize * simConfig.layermapSize;
+	double shellRotation = 0; // In radians, accumulated in double as it's only used to re-anchor the per-step rotation
+
+	// Add a ring on the top pole denoting the shell chuck, for reference
+	for (uint32_t pixelIndex : tables->chuckRingPixels)
+	{
+		if (!errorColumnsOnly)
+			layers[pixelIndex] += 3;
+		else if (errorColumnOfPixelX[pixelIndex % simConfig.layermapSize] >= 0)
+			layers[(pixelIndex / simConfig.layermapSize) * errorColumnCount + errorColumnOfPixelX[pixelIndex % simConfig.layermapSize]] += 3;
 	}
 
+	// The coverage is always left cleared after a simulation, so it only needs to be reset when the size changes
+	if (scratchCoverage.size() != (layerCount + 63) / 64)
+		scratchCoverage.assign((layerCount + 63) / 64, 0);
+
+	tapePixelIndices.resize(tables->tapeSampleCount);
+
 	// Simulate shell taping
-	while (currentAngleIndex < shellConfig.numAngles)
+	for (uint32_t currentAngleIndex = 0; currentAngleIndex < shellConfig.numAngles; currentAngleIndex++)
 	{
-		while (rimRotations < M_2PI * shellConfig.rimRotationsUntilNextAngle[currentAngleIndex])
+		const float armRotation = shellConfig.shellArmAngles[currentAngleIndex] * (M_PI / 180.0f); // In radians, 0 = straight up/down
+		const float sinArm = std::sin(armRotation), cosArm = std::cos(armRotation);
+
+		const double shellStepRotation = double(tables->radianFillStepSize) * shellConfig.shellStepperSpeed[currentAngleIndex];
+		const float sinShellStep = float(std::sin(shellStepRotation)), cosShellStep = float(std::cos(shellStepRotation));
+		float sinShell = 0, cosShell = 1;
+
+		// Each application starts back at the beginning of a rim rotation, and leftover coverage carries over to the next rotation
+		const uint64_t angleStepCount = uint64_t(std::ceil(double(stepsPerRimRotation) * shellConfig.rimRotationsUntilNextAngle[currentAngleIndex]));
+		uint32_t rimStep = 0;
+
+		for (uint64_t step = 0; step < angleStepCount; step++)
 		{
-			// Fill in the layermap where the tape is
-			for (float t = -tapeWidthRadians / 2.0f; t <= tapeWidthRadians / 2.0f; t += radianFillStepSize)
+			if (rimStep == 0)
 			{
-				glm::vec2 uv = convertShellToUV(rimRotations, armRotation, t, shellRotation);
-
-				scratchLayermap[uint32_t(uv.y * float(simConfig.layermapSize - 1)) * simConfig.layermapSize + uint32_t(uv.x * float(simConfig.layermapSize - 1))] = 1;
+				sinShell = float(std::sin(shellRotation));
+				cosShell = float(std::cos(shellRotation));
 			}
 
-			// Once every full rotation, reset the scratchmap
-			if (std::fmod(rimRotations, M_2PI) > std::fmod(rimRotations + radianFillStepSize, M_2PI))
+			const ShellTapeKernel kernel = computeShellTapeKernel(tables->rimSin[rimStep], tables->rimCos[rimStep], sinArm, cosArm, sinShell, cosShell);
+
+			// Fill in the layers where the tape is
+			if (!errorColumnsOnly)
+			{
+				projectTapeSamples(kernel, tables->tapeSin.data(), tables->tapeCos.data(), tables->tapeSampleCount, simConfig.layermapSize, simConfig.layermapSize, tapePixelIndices.data());
+
+				for (uint32_t t = 0; t < tables->tapeSampleCount; t++)
+					markCovered(tapePixelIndices[t]);
+			}
+			else
 			{
-				for (uint32_t i = 0; i < simConfig.layermapSize * simConfig.layermapSize; i++)
-					layermap[i] += scratchLayermap[i];
+				projectTapeSamples(kernel, tables->tapeSin.data(), tables->tapeCos.data(), tables->tapeSampleCount, simConfig.layermapSize, 1u << 16, tapePixelIndices.data());
 
-				memset(scratchLayermap, 0, sizeof(scratchLayermap[0]) * simConfig.layermapSize * simConfig.layermapSize);
+				for (uint32_t t = 0; t < tables->tapeSampleCount; t++)
+				{
+					const int32_t errorColumn = errorColumnOfPixelX[tapePixelIndices[t] & 0xFFFF];
+
+					if (errorColumn >= 0)
+						markCovered((tapePixelIndices[t] >> 16) * errorColumnCount + uint32_t(errorColumn));
+				}
+			}
+
+			// Once every full rotation, merge the covered pixels into the layers and reset the coverage
+			if (++rimStep == stepsPerRimRotation)
+			{
+				mergeScratchCoverage(layers, layerCount);
+				rimStep = 0;
 			}
 
 			// Step all the machine axes
-			shellRotation += radianFillStepSize * shellConfig.shellStepperSpeed[currentAngleIndex];
-			rimRotations += radianFillStepSize;
+			const float nextSinShell = sinShell * cosShellStep + cosShell * sinShellStep;
+			cosShell = cosShell * cosShellStep - sinShell * sinShellStep;
+			sinShell = nextSinShell;
+			shellRotation += shellStepRotation;
 		}
 
-		// Setup for the next angle/application
-		currentAngleIndex++;
-		rimRotations = std::fmod(rimRotations, radianFillStepSize);
+		// Give up once the error is guaranteed to be over the cutoff, layers are only ever added so too many can't get better
+		if (cutoff != nullptr && currentAngleIndex + 1 < shellConfig.numAngles)
+		{
+			const double errorLowerBound = computeLayerErrorLowerBound(layers, simConfig.layermapSize * errorColumnCount, cutoff->targetLayers) / double(simConfig.layermapSize) / double(cutoff->errorSweepCount);
+
+			// With a bit of slack for the rounding in the actual error computation
+			if (errorLowerBound * 0.999 > double(cutoff->errorCutoff))
+			{
+				cutoff->exceeded = true;
+				cutoff->errorLowerBound = uint32_t(std::min(errorLowerBound, double(UINT32_MAX)));
+
+				break;
+			}
+		}
+	}
+
+	// The last partial rotation is never merged, only cleared
+	for (uint32_t wordIndex : dirtyCoverageWords)
+		scratchCoverage[wordIndex] = 0;
+
+	dirtyCoverageWords.clear();
+}
+
+void ShellSimulation::mergeScratchCoverage(uint16_t *layers, uint32_t layerCount)
+{
+	for (uint32_t wordIndex : dirtyCoverageWords)
+	{
+		const uint64_t coverageWord = scratchCoverage[wordIndex];
+		uint16_t *layersWord = &layers[wordIndex * 64];
+
+		// The last word can run past the end of the layers, its bits past the end are never set
+		const uint32_t wordLayerCount = std::min<uint32_t>(64, layerCount - wordIndex * 64);
+
+		// Mostly covered words are unpacked branch-free (which vectorizes), sparse ones just visit their set bits
+		if (countSetBits(coverageWord) >= 16)
+		{
+			for (uint32_t b = 0; b < wordLayerCount; b++)
+				layersWord[b] += uint16_t((coverageWord >> b) & 1);
+		}
+		else
+		{
+			for (uint64_t bits = coverageWord; bits != 0; bits &= bits - 1)
+				layersWord[findLowestSetBit(bits)]++;
+		}
 
-		armRotation = shellConfig.shellArmAngles[currentAngleIndex] * (M_PI / 180.0f);
+		scratchCoverage[wordIndex] = 0;
 	}
+
+	dirtyCoverageWords.clear();
 }
 
 uint32_t ShellSimulation::computeLayermapError(const SimulationConfig &simConfig, uint32_t targetLayers, uint16_t *layermap)
 {
-	float totalError = 0.0f;
+	const uint32_t errorSweepCount = getErrorSweepCount(simConfig);
+	const uint32_t errorSweepStride = simConfig.layermapSize / errorSweepCount;
 
-	// Calculate error based on delta from the target layers
-	float absErr = 0;
-	float errFactor = 1.0f / float(simConfig.layermapSize);
+	return computeLayerError(layermap, simConfig.layermapSize, errorSweepStride, (simConfig.layermapSize + errorSweepStride - 1) / errorSweepStride, simConfig.layermapSize, errorSweepCount, targetLayers);
+}
+
+double ShellSimulation::computeLayerErrorLowerBound(const uint16_t *layers, uint32_t layerCount, uint32_t targetLayers)
+{
+	double overshootError = 0;
 
-	for (uint32_t x = 0; x < simConfig.layermapSize; x += simConfig.layermapSize / simConfig.errorCalcYAxisSweeps)
+	for (uint32_t i = 0; i < layerCount; i++)
 	{
-		for (uint32_t y = 0; y < simConfig.layermapSize; y++)
+		if (layers[i] > targetLayers)
 		{
-			uint32_t aboveLayerCount = layermap[std::max(int32_t(y) - 1, 0) * simConfig.layermapSize + x];
-			uint32_t layerCount = layermap[y * simConfig.layermapSize + x];
-			float layerError = std::pow(std::abs(float(targetLayers) - float(layerCount)), 4.0f);
-			float smoothnessError = std::pow(std::abs(float(layerCount) - float(aboveLayerCount)), 4.0f);
-
-			absErr += (layerError + smoothnessError) * errFactor;
+			const double overshoot = double(layers[i] - targetLayers);
+			overshootError += (overshoot * overshoot) * (overshoot * overshoot);
 		}
 	}
 
-	return uint32_t(absErr / float(simConfig.errorCalcYAxisSweeps));
+	return overshootError;
+}
+
+uint32_t ShellSimulation::computeLayerError(const uint16_t *layers, uint32_t rowPitch, uint32_t columnStride, uint32_t columnCount, uint32_t rowCount, uint32_t errorSweepCount, uint32_t targetLayers)
+{
+	// Calculate error based on delta from the target layers, going row by row so that every sweep is evaluated at once
+	double absErr = 0;
+
+	for (uint32_t y = 0; y < rowCount; y++)
+	{
+		const uint16_t *row = &layers[y * rowPitch];
+		const uint16_t *aboveRow = &layers[std::max(int32_t(y) - 1, 0) * rowPitch];
+
+		absErr += computeLayermapRowError(row, aboveRow, columnStride, columnCount, float(targetLayers));
+	}
+
+	return uint32_t(absErr / double(rowCount) / double(errorSweepCount));
 }
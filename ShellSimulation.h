@@ -1,15 +1,22 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 struct SimulationConfig
 {
 	uint32_t layermapSize; // Width & height of the map used to simulate layers
 	float mapFillPrecisionMult; // Multiplier for the precision when filling the layermap (a good starting value is 2-3)
-	uint32_t errorCalcYAxisSweeps; // How many Y axis sweeps to do across a layermap image when calculating the error, error is averaged for all the sweeps (a good starting value is 8)
+	uint32_t errorCalcYAxisSweeps; // How many Y axis sweeps to do across a layermap image when calculating the error, error is averaged for all the sweeps (a good starting value is 8, 0 sweeps every column)
 };
 
+// The number of columns computeLayermapError() sweeps, "errorCalcYAxisSweeps" clamped to the layermap's width
+inline uint32_t getErrorSweepCount(const SimulationConfig &simConfig)
+{
+	return (simConfig.errorCalcYAxisSweeps == 0 || simConfig.errorCalcYAxisSweeps > simConfig.layermapSize) ? simConfig.layermapSize : simConfig.errorCalcYAxisSweeps;
+}
+
 struct SearchConfig
 {
 	uint32_t numAngles; // Number of angles/applications per taping session
@@ -43,6 +50,8 @@ struct ShellConfig
 	std::vector<float> rimRotationsUntilNextAngle; // The number of rim rotations until the next angle, typically 1 / shellStepperSpeed to allow a full shell rotation per angle
 };
 
+struct ShellSimulationTables;
+
 class ShellSimulation
 {
 public:
@@ -51,16 +60,76 @@ public:
 
 	/*
 	Simulates a taping session on a shell. 
+
+	The result matches composing the full rotation matrix per sample (convertShellToUV()) up to rounding. The rim step is rounded so
+	that a whole number of steps make up a rotation (exact when layermapSize * mapFillPrecisionMult is an integer), and the machine
+	axes are stepped by an integer step count instead of accumulating float angles, so samples may shift by a pixel compared to
+	accumulating the angles directly.
+
 	@param[out] layermap The image to write the layers to, all elements must be set to 0
-	@param[out] scratchLayermap An image the same size as "layermap" used for calculations, all elements must be set to 0
 	*/
-	void simulateTaping(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint16_t *layermap, uint16_t *scratchLayermap);
+	void simulateTaping(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint16_t *layermap);
 
 	/*
-	Computes the average error of a computed shell layermap.
+	Computes the average error of a computed shell layermap. Each pixel's error is the 4th power of its difference from the target layers, plus
+	the 4th power of its difference from the pixel above it (for smoothness). This is vectorized across rows, so sweeping every column
+	costs about as much as reading the layermap once.
 
 	@return A positive integer with no bounds besides uint32_t limits.
 	*/
 	uint32_t computeLayermapError(const SimulationConfig &simConfig, uint32_t targetLayers, uint16_t *layermap);
-};
 
+	/*
+	Simulates a taping session and returns the same error computeLayermapError() would give for its layermap. Only the columns the error
+	samples are kept track of instead of a full layermap, so this is the much cheaper option when only the error is needed.
+
+	@param[in] errorCutoff If after any application the error is guaranteed to end up above this, the simulation stops early and returns a
+	lower bound of the error instead (which is still above the cutoff). The bound only counts pixels already over "targetLayers", as layers
+	are never removed.
+	*/
+	uint32_t simulateTapingError(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint32_t targetLayers, uint32_t errorCutoff = UINT32_MAX);
+
+private:
+	std::shared_ptr<const ShellSimulationTables> tables; // The tables for the last simulated config
+
+	// Kept between simulations to avoid reallocating them for every shell
+	std::vector<uint32_t> tapePixelIndices;
+
+	std::vector<uint64_t> scratchCoverage; // One bit per layer pixel, set if the tape covered it during the current rim rotation
+	std::vector<uint32_t> dirtyCoverageWords; // Indices of the nonzero words in "scratchCoverage"
+
+	// The layers of only the columns computeLayermapError() samples, row major, for simulateTapingError()
+	std::vector<uint16_t> errorColumnLayers;
+	std::vector<int32_t> errorColumnOfPixelX; // For each layermap column, its column in "errorColumnLayers", or -1 if it isn't sampled
+	uint32_t errorColumnStride;
+	uint32_t errorColumnCount;
+
+	struct ErrorCutoff
+	{
+		uint32_t targetLayers;
+		uint32_t errorSweepCount;
+		uint32_t errorCutoff;
+
+		bool exceeded; // Set if the simulation stopped early
+		uint32_t errorLowerBound;
+	};
+
+	/*
+	Simulates taping into either a full layermap or, if "errorColumnsOnly" is set, the layout of "errorColumnLayers". If "cutoff"
+	is given, the error is checked against it after every application.
+	*/
+	void simulateTapingLayers(const ShellConfig &shellConfig, const SimulationConfig &simConfig, uint16_t *layers, bool errorColumnsOnly, ErrorCutoff *cutoff = nullptr);
+	void mergeScratchCoverage(uint16_t *layers, uint32_t layerCount);
+	double computeLayerErrorLowerBound(const uint16_t *layers, uint32_t layerCount, uint32_t targetLayers);
+	uint32_t computeLayerError(const uint16_t *layers, uint32_t rowPitch, uint32_t columnStride, uint32_t columnCount, uint32_t rowCount, uint32_t errorSweepCount, uint32_t targetLayers);
+
+	inline void markCovered(uint32_t layerIndex)
+	{
+		uint64_t &coverageWord = scratchCoverage[layerIndex >> 6];
+
+		if (coverageWord == 0)
+			dirtyCoverageWords.push_back(layerIndex >> 6);
+
+		coverageWord |= uint64_t(1) << (layerIndex & 63);
+	}
+};
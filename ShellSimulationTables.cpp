@@ -0,0 +1,84 @@
+#include "ShellSimulationTables.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <util.h>
+#include <ShellProjection.h>
+
+static std::shared_ptr<const ShellSimulationTables> buildShellSimulationTables(const ShellConfig &shellConfig, const SimulationConfig &simConfig)
+{
+	std::shared_ptr<ShellSimulationTables> tables = std::make_shared<ShellSimulationTables>();
+	tables->layermapSize = simConfig.layermapSize;
+	tables->mapFillPrecisionMult = simConfig.mapFillPrecisionMult;
+	tables->shellDiameter = shellConfig.shellDiameter;
+	tables->tapeWidth = shellConfig.tapeWidth;
+	tables->shellChuckDiameter = shellConfig.shellChuckDiameter;
+
+	tables->stepsPerRimRotation = std::max<uint32_t>(uint32_t(std::round(simConfig.layermapSize * simConfig.mapFillPrecisionMult)), 1);
+	tables->radianFillStepSize = float(M_2PI / double(tables->stepsPerRimRotation));
+
+	for (uint32_t s = 0; s < tables->stepsPerRimRotation; s++)
+	{
+		const double rimRotation = s * (M_2PI / double(tables->stepsPerRimRotation));
+
+		tables->rimSin.push_back(float(std::sin(rimRotation)));
+		tables->rimCos.push_back(float(std::cos(rimRotation)));
+	}
+
+	const float tapeWidthRadians = (shellConfig.tapeWidth / (shellConfig.shellDiameter * M_PI)) * M_PI;
+
+	for (float t = -tapeWidthRadians / 2.0f; t <= tapeWidthRadians / 2.0f; t += tables->radianFillStepSize)
+	{
+		tables->tapeSin.push_back(std::sin(t));
+		tables->tapeCos.push_back(std::cos(t));
+	}
+
+	// Pad the samples to a full batch for the vectorized projection by repeating the last one, which just covers the same pixel again
+	tables->tapeSampleCount = ((uint32_t(tables->tapeSin.size()) + tapeProjectionBatchSize - 1) / tapeProjectionBatchSize) * tapeProjectionBatchSize;
+	tables->tapeSin.resize(tables->tapeSampleCount, tables->tapeSin.back());
+	tables->tapeCos.resize(tables->tapeSampleCount, tables->tapeCos.back());
+
+	const float shellChuckContactAngle = M_2PI * (shellConfig.shellChuckDiameter / (M_PI * shellConfig.shellDiameter));
+
+	for (float f = 0; f < M_2PI; f += tables->radianFillStepSize)
+	{
+		glm::vec2 uv = convertShellChuckToUV(shellChuckContactAngle, f);
+
+		tables->chuckRingPixels.push_back(uint32_t(uv.y * float(simConfig.layermapSize - 1)) * simConfig.layermapSize + uint32_t(uv.x * float(simConfig.layermapSize - 1)));
+	}
+
+	std::sort(tables->chuckRingPixels.begin(), tables->chuckRingPixels.end());
+	tables->chuckRingPixels.erase(std::unique(tables->chuckRingPixels.begin(), tables->chuckRingPixels.end()), tables->chuckRingPixels.end());
+
+	return tables;
+}
+
+bool ShellSimulationTables::matches(const ShellConfig &shellConfig, const SimulationConfig &simConfig) const
+{
+	return layermapSize == simConfig.layermapSize && mapFillPrecisionMult == simConfig.mapFillPrecisionMult && shellDiameter == shellConfig.shellDiameter
+		&& tapeWidth == shellConfig.tapeWidth && shellChuckDiameter == shellConfig.shellChuckDiameter;
+}
+
+std::shared_ptr<const ShellSimulationTables> ShellSimulationTables::get(const ShellConfig &shellConfig, const SimulationConfig &simConfig)
+{
+	static std::mutex tablesCache_mutex;
+	static std::vector<std::shared_ptr<const ShellSimulationTables>> tablesCache;
+
+	// There's only ever a handful of configs per run, so a linear search is fine
+	std::lock_guard<std::mutex> lck(tablesCache_mutex);
+
+	for (const std::shared_ptr<const ShellSimulationTables> &tables : tablesCache)
+		if (tables->matches(shellConfig, simConfig))
+			return tables;
+
+	tablesCache.push_back(buildShellSimulationTables(shellConfig, simConfig));
+
+	return tablesCache.back();
+}
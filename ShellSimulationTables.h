@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <ShellSimulation.h>
+
+/*
+Everything a simulation needs that only depends on the SimulationConfig and the shell/tape/chuck dimensions, which are the same
+for every member of a population. Tables are built once and shared read-only between all threads, which takes the trig for the
+rim rotation and the tape offsets off of the simulation's hot path.
+*/
+struct ShellSimulationTables
+{
+	// The parameters the tables were built for
+	uint32_t layermapSize;
+	float mapFillPrecisionMult;
+	float shellDiameter;
+	float tapeWidth;
+	float shellChuckDiameter;
+
+	uint32_t stepsPerRimRotation; // The rim step is rounded so that a whole number of steps make up a rotation
+	float radianFillStepSize;
+
+	std::vector<float> rimSin, rimCos; // Indexed by the step within the current rim rotation
+
+	// The offsets across the tape's width, padded to a multiple of "tapeProjectionBatchSize"
+	uint32_t tapeSampleCount;
+	std::vector<float> tapeSin, tapeCos;
+
+	std::vector<uint32_t> chuckRingPixels; // Pixels of the ring marking the shell chuck, sorted & unique
+
+	bool matches(const ShellConfig &shellConfig, const SimulationConfig &simConfig) const;
+
+	/*
+	Returns the tables for a config, building them if no simulation has used the same parameters before. Thread safe, and the returned
+	tables are never modified.
+	*/
+	static std::shared_ptr<const ShellSimulationTables> get(const ShellConfig &shellConfig, const SimulationConfig &simConfig);
+};
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #define M_PI 3.1415926535897932384
 #define M_2PI 6.2831853071795864769
 
@@ -8,6 +14,28 @@ inline float saturate(float f)
 	return f > 1.0f ? 1.0f : (f < 0.0f ? 0.0f : f);
 }
 
+inline uint32_t countSetBits(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	return uint32_t(__popcnt64(bits));
+#else
+	return uint32_t(__builtin_popcountll(bits));
+#endif
+}
+
+// Index of the lowest set bit, "bits" must not be 0
+inline uint32_t findLowestSetBit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+
+	return uint32_t(index);
+#else
+	return uint32_t(__builtin_ctzll(bits));
+#endif
+}
+
 // Converts a unit vector direction to UV coordinates
 inline glm::vec2 convertDirToUV(glm::vec3 dir)
 {
@@ -50,6 +78,42 @@ inline glm::vec2 convertShellToUV(float rimRotation, float armRotation, float ta
 	return convertDirToUV(glm::vec3(dir.x, dir.y, dir.z));
 }
 
+/*
+The shell, arm and rim rotations of convertShellToUV() composed once for a single simulation step. Since the tape
+rotation is applied last, the direction for any tape offset "t" is a closed-form rotation between two basis vectors:
+	dir(t) = cos(t) * tapeCenterDir + sin(t) * tapeSideDir
+*/
+struct ShellTapeKernel
+{
+	glm::vec3 tapeCenterDir; // The direction of the center of the tape (t = 0)
+	glm::vec3 tapeSideDir; // The direction the tape sweeps toward as t increases
+};
+
+// Same as below, but with the sin & cos of each rotation already computed
+inline ShellTapeKernel computeShellTapeKernel(float sinRim, float cosRim, float sinArm, float cosArm, float sinShell, float cosShell)
+{
+	// Equivalent to Ry(shell) * Rz(arm) * Rx(rim) applied to the +Y and -X axes
+	ShellTapeKernel kernel;
+	kernel.tapeCenterDir = glm::vec3(sinShell * sinRim - cosShell * sinArm * cosRim, cosArm * cosRim, sinShell * sinArm * cosRim + cosShell * sinRim);
+	kernel.tapeSideDir = glm::vec3(-cosShell * cosArm, -sinArm, sinShell * cosArm);
+
+	return kernel;
+}
+
+inline ShellTapeKernel computeShellTapeKernel(float rimRotation, float armRotation, float shellRotation)
+{
+	return computeShellTapeKernel(std::sin(rimRotation), std::cos(rimRotation), std::sin(armRotation), std::cos(armRotation), std::sin(shellRotation), std::cos(shellRotation));
+}
+
+// Same result as convertShellToUV() for the step the kernel was computed for, "sinTape" & "cosTape" being the sin & cos of the tape rotation
+inline glm::vec2 convertShellTapeToUV(const ShellTapeKernel &kernel, float sinTape, float cosTape)
+{
+	return convertDirToUV(glm::vec3(
+		cosTape * kernel.tapeCenterDir.x + sinTape * kernel.tapeSideDir.x,
+		cosTape * kernel.tapeCenterDir.y + sinTape * kernel.tapeSideDir.y,
+		cosTape * kernel.tapeCenterDir.z + sinTape * kernel.tapeSideDir.z));
+}
+
 inline glm::vec2 convertShellChuckToUV(float chuckRotation, float step)
 {
 	glm::mat4 rotation = glm::mat4(1);